@@ -5,6 +5,7 @@
 
 #if defined(ARDUINO) || defined(OF_VERSION_MAJOR) || defined(SERIAL_H)
 #define MSGPACKETIZER_ENABLE_STREAM
+#define MSGPACKETIZER_ENABLE_PACKETIZER_STREAM  // StreamType is read and written by Packetizer
 #ifdef ARDUINO  // TODO: support more platforms
 #if defined(ESP_PLATFORM) || defined(ESP8266) || defined(ARDUINO_AVR_UNO_WIFI_REV2)                             \
     || defined(ARDUINO_SAMD_MKRWIFI1010) || defined(ARDUINO_SAMD_MKRVIDOR4000) || defined(ARDUINO_SAMD_MKR1000) \
@@ -17,6 +18,11 @@
 #endif
 #endif
 
+// hosted POSIX sockets and file descriptors can be used without Arduino, oF or serial library
+#if defined(MSGPACKETIZER_ENABLE_POSIX) && !defined(MSGPACKETIZER_ENABLE_STREAM)
+#define MSGPACKETIZER_ENABLE_STREAM
+#endif
+
 #ifdef MSGPACKETIZER_DISABLE_NETWORK
 #define PACKETIZER_DISABLE_NETWORK
 #else
@@ -24,9 +30,46 @@
 #define MSGPACKETIZER_ENABLE_NETWORK
 #include <Udp.h>
 #include <Client.h>
+#elif defined(MSGPACKETIZER_ENABLE_POSIX)
+#define MSGPACKETIZER_ENABLE_NETWORK
 #endif
 #endif // MSGPACKETIZER_DISABLE_NETWORK
 
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+#if defined(ARDUINO) || !(defined(__unix__) || defined(__APPLE__))
+#error "MSGPACKETIZER_ENABLE_POSIX is only available on hosted POSIX platforms"
+#endif
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef __linux__
+#define MSGPACKETIZER_ENABLE_SHM
+#include <atomic>
+#include <climits>
+#include <new>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#endif  // MSGPACKETIZER_ENABLE_POSIX
+
 #if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
 // use standard c++ libraries
 #else
@@ -36,6 +79,21 @@
 #ifndef MSGPACKETIZER_MAX_PUBLISH_DESTINATION_SIZE
 #define MSGPACKETIZER_MAX_PUBLISH_DESTINATION_SIZE 2
 #endif
+#ifndef MSGPACKETIZER_MAX_OUTBOUND_QUEUE_SIZE
+#define MSGPACKETIZER_MAX_OUTBOUND_QUEUE_SIZE 2
+#endif
+#ifndef MSGPACKETIZER_MAX_CONST_FRAME_SIZE
+#define MSGPACKETIZER_MAX_CONST_FRAME_SIZE 1
+#endif
+#ifndef MSGPACKETIZER_MAX_ROUTE_SIZE
+#define MSGPACKETIZER_MAX_ROUTE_SIZE 2
+#endif
+#ifndef MSGPACKETIZER_MAX_TAP_SIZE
+#define MSGPACKETIZER_MAX_TAP_SIZE 1
+#endif
+#ifndef MSGPACKETIZER_MAX_RELIABLE_CHANNEL_SIZE
+#define MSGPACKETIZER_MAX_RELIABLE_CHANNEL_SIZE 1
+#endif
 #ifndef MSGPACK_MAX_PACKET_BYTE_SIZE
 #define MSGPACK_MAX_PACKET_BYTE_SIZE 96
 #endif
@@ -76,6 +134,58 @@
 #include <Packetizer.h>
 #include <MsgPack.h>
 
+// storage of following features is fixed on NO-STL boards even if they are not used,
+// so they are enabled only if defined (they allocate memory only when they are used on other boards)
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+#ifndef MSGPACKETIZER_ENABLE_FRAGMENT
+#define MSGPACKETIZER_ENABLE_FRAGMENT
+#endif
+#ifndef MSGPACKETIZER_ENABLE_OUTBOUND_QUEUE
+#define MSGPACKETIZER_ENABLE_OUTBOUND_QUEUE
+#endif
+#ifndef MSGPACKETIZER_ENABLE_CONST_FRAME
+#define MSGPACKETIZER_ENABLE_CONST_FRAME
+#endif
+#ifndef MSGPACKETIZER_ENABLE_LATENCY
+#define MSGPACKETIZER_ENABLE_LATENCY
+#endif
+#ifndef MSGPACKETIZER_ENABLE_RELIABLE
+#define MSGPACKETIZER_ENABLE_RELIABLE
+#endif
+#endif  // have libstdc++11
+
+#ifdef MSGPACKETIZER_ENABLE_THREAD
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#else
+#error "MSGPACKETIZER_ENABLE_THREAD requires standard c++ libraries"
+#endif
+#endif  // MSGPACKETIZER_ENABLE_THREAD
+
+#ifdef MSGPACKETIZER_ENABLE_STATS
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#else
+#error "MSGPACKETIZER_ENABLE_STATS requires standard c++ libraries"
+#endif
+#endif  // MSGPACKETIZER_ENABLE_STATS
+
+#if defined(MSGPACKETIZER_TRACE_SINK) && !defined(ARDUINO)
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#endif  // MSGPACKETIZER_TRACE_SINK
+
 namespace arduino {
 namespace msgpack {
     namespace msgpacketizer {
@@ -93,6 +203,21 @@ namespace msgpack {
         using namespace std::chrono;
         steady_clock::time_point time_start {steady_clock::now()};
 #define MSGPACKETIZER_ELAPSED_MICROS() duration_cast<microseconds>(steady_clock::now() - time_start).count()
+#elif defined(MSGPACKETIZER_ENABLE_POSIX)
+        namespace posix {
+            class Socket;
+        }
+        using StreamType = posix::Socket;  // only used to refer to posix streams
+        using namespace std::chrono;
+        // function-local static so that every translation unit shares one epoch
+        inline steady_clock::time_point& time_start() {
+            static steady_clock::time_point t {steady_clock::now()};
+            return t;
+        }
+#define MSGPACKETIZER_ELAPSED_MICROS()                                                      \
+    std::chrono::duration_cast<std::chrono::microseconds>(                                  \
+        std::chrono::steady_clock::now() - ::arduino::msgpack::msgpacketizer::time_start()) \
+        .count()
 #endif
 
 #ifdef ARDUINO
@@ -110,14 +235,43 @@ namespace msgpack {
             STREAM_SERIAL,
             STREAM_UDP,
             STREAM_TCP,
+            STREAM_FD,   // posix::Stream (pipe, fifo, tty, unix domain socket)
+            STREAM_SHM,  // posix::SharedMemory
         };
 
+        namespace detail {
+#ifdef MSGPACKETIZER_ENABLE_THREAD
+            using Mutex = std::recursive_mutex;
+            using LockGuard = std::lock_guard<Mutex>;
+#else
+            struct Mutex {};
+            struct LockGuard {
+                explicit LockGuard(Mutex&) {}
+            };
+#endif
+        }  // namespace detail
+
     }  // namespace msgpacketizer
 }  // namespace msgpack
 }  // namespace arduino
 
+#include "MsgPacketizer/Memory.h"
+#include "MsgPacketizer/Codec.h"
+#include "MsgPacketizer/Trace.h"
+#include "MsgPacketizer/Fragment.h"
+#include "MsgPacketizer/Latency.h"
+#include "MsgPacketizer/Reliable.h"
+#include "MsgPacketizer/Pool.h"
+#include "MsgPacketizer/Posix.h"
+#include "MsgPacketizer/Shm.h"
+#include "MsgPacketizer/Stats.h"
 #include "MsgPacketizer/Publisher.h"
 #include "MsgPacketizer/Subscriber.h"
+#include "MsgPacketizer/Router.h"
+#include "MsgPacketizer/Static.h"
+#include "MsgPacketizer/Worker.h"
+#include "MsgPacketizer/Capture.h"
+#include "MsgPacketizer/Offline.h"
 
 namespace MsgPacketizer = arduino::msgpack::msgpacketizer;
 
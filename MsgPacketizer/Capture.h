@@ -0,0 +1,376 @@
+#pragma once
+
+#ifndef HT_SERIAL_MSGPACKETIZER_CAPTURE_H
+#define HT_SERIAL_MSGPACKETIZER_CAPTURE_H
+
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+
+namespace arduino {
+namespace msgpack {
+    namespace msgpacketizer {
+
+        // Capture file of decoded packets
+        //
+        // [FileHeader]
+        // [FrameHeader][payload][padding to 8 bytes] ...
+        // [IndexTable][IndexEntry] ... [uint64_t offsets of frames of each index] ...
+        //
+        // IndexTable is written by Recorder::close(). If the file was not closed properly,
+        // Replayer builds the index by scanning frames.
+        namespace capture {
+
+            static constexpr char MAGIC[8] {'M', 'P', 'K', 'T', 'C', 'A', 'P', '\0'};
+            static constexpr uint32_t VERSION {1};
+
+            struct FileHeader {
+                char magic[8];
+                uint32_t version;
+                uint32_t reserved;
+                uint64_t start_unix_us;  // wall clock when recording started
+                uint64_t n_frames;
+                uint64_t index_offset;  // 0 if index table is not written
+            };
+
+            struct FrameHeader {
+                uint64_t timestamp_us;  // from start of recording
+                uint32_t size;
+                uint8_t index;
+                uint8_t channel;  // attached stream
+                uint8_t reserved[2];
+            };
+
+            struct IndexTable {
+                uint32_t n_entries;
+                uint32_t reserved;
+            };
+
+            struct IndexEntry {
+                uint8_t index;
+                uint8_t reserved[3];
+                uint32_t count;
+                uint64_t offset;  // of uint64_t array of frame offsets
+            };
+
+            inline uint64_t align(const uint64_t size) {
+                return (size + 7) & ~(uint64_t)7;
+            }
+
+            enum class Pace : uint8_t {
+                RECORDED,  // keep recorded intervals between frames
+                FAST,      // as fast as possible
+            };
+
+            // records every packet dispatched to attached streams
+            class Recorder {
+                FILE* fp {nullptr};
+                uint64_t pos {0};
+                uint64_t n_frames {0};
+                int64_t t_start {0};
+                std::map<uint8_t, std::vector<uint64_t>> offsets;
+                std::vector<ReceiverRef> receivers;
+                detail::Mutex mtx;
+
+            public:
+                Recorder() {}
+                Recorder(const Recorder&) = delete;
+                Recorder& operator=(const Recorder&) = delete;
+                ~Recorder() {
+                    close();
+                }
+
+                bool open(const char* path) {
+                    close();
+                    fp = std::fopen(path, "wb");
+                    if (!fp) {
+                        LOG_ERROR(F("cannot open capture file: "), path);
+                        return false;
+                    }
+                    FileHeader h;
+                    std::memset(&h, 0, sizeof(h));
+                    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+                    h.version = VERSION;
+                    h.start_unix_us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                                          std::chrono::system_clock::now().time_since_epoch())
+                                          .count();
+                    std::fwrite(&h, sizeof(h), 1, fp);
+                    pos = sizeof(h);
+                    n_frames = 0;
+                    offsets.clear();
+                    t_start = (int64_t)MSGPACKETIZER_ELAPSED_MICROS();
+                    return true;
+                }
+
+                bool isOpen() const {
+                    return fp != nullptr;
+                }
+
+                // record packets of the stream, returns channel number of the stream in this file
+                template <typename S>
+                uint8_t attach(S& stream) {
+                    const uint8_t channel = (uint8_t)receivers.size();
+                    ReceiverRef receiver = detail::getReceiverRef(stream);
+                    receiver->tap(this, [this, channel](const uint8_t index, const uint8_t* data, const size_t size) {
+                        write(channel, index, data, size);
+                    });
+                    receivers.push_back(receiver);
+                    return channel;
+                }
+
+                void write(const uint8_t channel, const uint8_t index, const uint8_t* data, const size_t size) {
+                    detail::LockGuard lock(mtx);
+                    if (!fp) return;
+                    static constexpr uint8_t padding[8] {};
+                    FrameHeader h;
+                    std::memset(&h, 0, sizeof(h));
+                    h.timestamp_us = (uint64_t)((int64_t)MSGPACKETIZER_ELAPSED_MICROS() - t_start);
+                    h.size = (uint32_t)size;
+                    h.index = index;
+                    h.channel = channel;
+                    const uint64_t len = sizeof(h) + size;
+                    std::fwrite(&h, sizeof(h), 1, fp);
+                    std::fwrite(data, 1, size, fp);
+                    std::fwrite(padding, 1, align(len) - len, fp);
+                    offsets[index].push_back(pos);
+                    pos += align(len);
+                    ++n_frames;
+                }
+
+                // detach streams and write index table
+                void close() {
+                    for (auto& r : receivers) r->untap(this);
+                    receivers.clear();
+                    detail::LockGuard lock(mtx);
+                    if (!fp) return;
+
+                    const uint64_t index_offset = pos;
+                    IndexTable table {(uint32_t)offsets.size(), 0};
+                    std::fwrite(&table, sizeof(table), 1, fp);
+                    uint64_t array_offset = index_offset + sizeof(table) + offsets.size() * sizeof(IndexEntry);
+                    for (auto& o : offsets) {
+                        IndexEntry e;
+                        std::memset(&e, 0, sizeof(e));
+                        e.index = o.first;
+                        e.count = (uint32_t)o.second.size();
+                        e.offset = array_offset;
+                        std::fwrite(&e, sizeof(e), 1, fp);
+                        array_offset += o.second.size() * sizeof(uint64_t);
+                    }
+                    for (auto& o : offsets) std::fwrite(o.second.data(), sizeof(uint64_t), o.second.size(), fp);
+
+                    std::fseek(fp, offsetof(FileHeader, n_frames), SEEK_SET);
+                    std::fwrite(&n_frames, sizeof(n_frames), 1, fp);
+                    std::fwrite(&index_offset, sizeof(index_offset), 1, fp);
+                    std::fclose(fp);
+                    fp = nullptr;
+                }
+
+                uint64_t frames() const {
+                    return n_frames;
+                }
+            };
+
+            // maps capture file and dispatches frames to subscribers of bound streams
+            class Replayer {
+                struct Span {
+                    const uint64_t* offsets;
+                    size_t count;
+                };
+
+                const uint8_t* data {nullptr};
+                size_t data_size {0};
+                uint64_t frames_end {0};
+                FileHeader header;
+                std::map<uint8_t, Span> spans;
+                std::map<uint8_t, std::vector<uint64_t>> scanned;  // index built when the file has no index table
+                std::map<uint8_t, ReceiverRef> bindings;
+                uint64_t cursor {0};
+                int64_t t_replay {0};
+
+            public:
+                Replayer() {}
+                Replayer(const Replayer&) = delete;
+                Replayer& operator=(const Replayer&) = delete;
+                ~Replayer() {
+                    close();
+                }
+
+                bool open(const char* path) {
+                    close();
+                    const int fd = ::open(path, O_RDONLY);
+                    if (fd < 0) {
+                        LOG_ERROR(F("cannot open capture file: "), path);
+                        return false;
+                    }
+                    struct stat st;
+                    if ((::fstat(fd, &st) < 0) || ((size_t)st.st_size < sizeof(FileHeader))) {
+                        ::close(fd);
+                        LOG_ERROR(F("invalid capture file: "), path);
+                        return false;
+                    }
+                    void* addr = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                    ::close(fd);
+                    if (addr == MAP_FAILED) return false;
+                    ::madvise(addr, (size_t)st.st_size, MADV_SEQUENTIAL);
+                    data = reinterpret_cast<const uint8_t*>(addr);
+                    data_size = (size_t)st.st_size;
+
+                    std::memcpy(&header, data, sizeof(header));
+                    if ((std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) || (header.version != VERSION)) {
+                        LOG_ERROR(F("invalid capture file: "), path);
+                        close();
+                        return false;
+                    }
+                    if (header.index_offset && (header.index_offset <= data_size)) {
+                        frames_end = header.index_offset;
+                        loadIndex();
+                    } else {
+                        frames_end = data_size;
+                        scanIndex();
+                    }
+                    rewind();
+                    return true;
+                }
+
+                void close() {
+                    if (data) ::munmap(const_cast<uint8_t*>(data), data_size);
+                    data = nullptr;
+                    data_size = 0;
+                    spans.clear();
+                    scanned.clear();
+                }
+
+                bool isOpen() const {
+                    return data != nullptr;
+                }
+
+                // wall clock (unix time in usec) when recording started
+                uint64_t startTime() const {
+                    return header.start_unix_us;
+                }
+
+                // dispatch frames of `channel` to subscribers of `stream`
+                template <typename S>
+                void bind(const uint8_t channel, S& stream) {
+                    auto& manager = UnpackerManager::getInstance();
+                    bindings[channel] = manager.getReceiverRef(manager.getDecodeTargetStream(stream));
+                }
+
+                void rewind() {
+                    cursor = sizeof(FileHeader);
+                    t_replay = (int64_t)MSGPACKETIZER_ELAPSED_MICROS();
+                }
+
+                bool finished() const {
+                    return !next(cursor);
+                }
+
+                // dispatch frames whose recorded time has come, returns the number of dispatched frames
+                size_t update() {
+                    const uint64_t now = (uint64_t)((int64_t)MSGPACKETIZER_ELAPSED_MICROS() - t_replay);
+                    size_t n = 0;
+                    FrameHeader h;
+                    while (next(cursor, &h) && (h.timestamp_us <= now)) {
+                        dispatch(h, cursor);
+                        cursor += align(sizeof(h) + h.size);
+                        ++n;
+                    }
+                    return n;
+                }
+
+                // dispatch all remaining frames
+                size_t run(const Pace pace = Pace::FAST) {
+                    size_t n = 0;
+                    FrameHeader h;
+                    while (next(cursor, &h)) {
+                        if (pace == Pace::RECORDED) {
+                            const int64_t due = t_replay + (int64_t)h.timestamp_us;
+                            const int64_t wait = due - (int64_t)MSGPACKETIZER_ELAPSED_MICROS();
+                            if (wait > 0) std::this_thread::sleep_for(std::chrono::microseconds(wait));
+                        }
+                        dispatch(h, cursor);
+                        cursor += align(sizeof(h) + h.size);
+                        ++n;
+                    }
+                    return n;
+                }
+
+                uint64_t frames() const {
+                    uint64_t n = 0;
+                    for (auto& s : spans) n += s.second.count;
+                    return n;
+                }
+
+                uint64_t frames(const uint8_t index) const {
+                    auto it = spans.find(index);
+                    return (it == spans.end()) ? 0 : it->second.count;
+                }
+
+                // `callback(timestamp_us, data, size)` for every frame of the index without touching others
+                template <typename F>
+                void forEach(const uint8_t index, F&& callback) const {
+                    auto it = spans.find(index);
+                    if (it == spans.end()) return;
+                    FrameHeader h;
+                    for (size_t i = 0; i < it->second.count; ++i) {
+                        const uint64_t offset = it->second.offsets[i];
+                        if (!next(offset, &h)) break;
+                        callback(h.timestamp_us, data + offset + sizeof(h), (size_t)h.size);
+                    }
+                }
+
+            private:
+                // read frame header at offset, false if no complete frame
+                bool next(const uint64_t offset, FrameHeader* h = nullptr) const {
+                    if (!data || (offset + sizeof(FrameHeader) > frames_end)) return false;
+                    FrameHeader fh;
+                    std::memcpy(&fh, data + offset, sizeof(fh));
+                    if (offset + sizeof(fh) + fh.size > frames_end) return false;
+                    if (h) *h = fh;
+                    return true;
+                }
+
+                void dispatch(const FrameHeader& h, const uint64_t offset) {
+                    auto it = bindings.find(h.channel);
+                    if (it != bindings.end()) it->second->replay(h.index, data + offset + sizeof(h), h.size);
+                }
+
+                void loadIndex() {
+                    IndexTable table;
+                    std::memcpy(&table, data + header.index_offset, sizeof(table));
+                    const uint64_t entries = header.index_offset + sizeof(table);
+                    if (entries + table.n_entries * sizeof(IndexEntry) > data_size) {
+                        LOG_WARN(F("broken index table, scan frames instead"));
+                        scanIndex();
+                        return;
+                    }
+                    for (uint32_t i = 0; i < table.n_entries; ++i) {
+                        IndexEntry e;
+                        std::memcpy(&e, data + entries + i * sizeof(IndexEntry), sizeof(e));
+                        if ((e.offset % sizeof(uint64_t)) || (e.offset + e.count * sizeof(uint64_t) > data_size)) {
+                            LOG_WARN(F("broken index table, scan frames instead"));
+                            scanIndex();
+                            return;
+                        }
+                        spans[e.index] = Span {reinterpret_cast<const uint64_t*>(data + e.offset), e.count};
+                    }
+                }
+
+                void scanIndex() {
+                    spans.clear();
+                    scanned.clear();
+                    FrameHeader h;
+                    for (uint64_t offset = sizeof(FileHeader); next(offset, &h); offset += align(sizeof(h) + h.size))
+                        scanned[h.index].push_back(offset);
+                    for (auto& s : scanned) spans[s.first] = Span {s.second.data(), s.second.size()};
+                }
+            };
+
+        }  // namespace capture
+
+    }  // namespace msgpacketizer
+}  // namespace msgpack
+}  // namespace arduino
+
+#endif  // MSGPACKETIZER_ENABLE_POSIX
+
+#endif  // HT_SERIAL_MSGPACKETIZER_CAPTURE_H
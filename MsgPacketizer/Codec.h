@@ -0,0 +1,160 @@
+#pragma once
+
+#ifndef HT_SERIAL_MSGPACKETIZER_CODEC_H
+#define HT_SERIAL_MSGPACKETIZER_CODEC_H
+
+// COBS encoded frames (without delimiter) longer than this are dropped by codec::Decoder
+#ifndef MSGPACKETIZER_MAX_DECODE_FRAME_SIZE
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+#define MSGPACKETIZER_MAX_DECODE_FRAME_SIZE (1024 * 1024)
+#else
+#define MSGPACKETIZER_MAX_DECODE_FRAME_SIZE PACKETIZER_MAX_PACKET_BINARY_SIZE
+#endif
+#endif
+
+namespace arduino {
+namespace msgpack {
+    namespace msgpacketizer {
+
+        // Self-contained implementation of the Packetizer wire format
+        // (COBS([index][payload][crc8]) + 0x00). Unlike Packetizer::encode/decode,
+        // it has no global buffers, so every instance can be used from its own thread.
+        namespace codec {
+
+            static constexpr uint8_t DELIMITER {0x00};
+
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+            using Buffer = std::vector<uint8_t>;
+#else
+            using Buffer = arx::stdx::vector<uint8_t, PACKETIZER_MAX_PACKET_BINARY_SIZE>;
+#endif
+
+            // CRC-8/SMBUS (poly 0x07, init 0x00), same as Packetizer
+            inline uint8_t crc8(const uint8_t* data, const size_t size) {
+                uint8_t crc = 0x00;
+                for (size_t i = 0; i < size; ++i) {
+                    crc ^= data[i];
+                    for (uint8_t b = 0; b < 8; ++b)
+                        crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+                }
+                return crc;
+            }
+
+            // append encoded frame (including delimiter) to `out`
+            template <typename B>
+            inline void encode(const uint8_t index, const uint8_t* data, const size_t size, B& out) {
+                size_t code_pos = out.size();
+                uint8_t code = 1;
+                out.push_back(0);
+                auto put = [&](const uint8_t b) {
+                    if (b == 0) {
+                        out[code_pos] = code;
+                        code_pos = out.size();
+                        out.push_back(0);
+                        code = 1;
+                    } else {
+                        out.push_back(b);
+                        if (++code == 0xFF) {
+                            out[code_pos] = code;
+                            code_pos = out.size();
+                            out.push_back(0);
+                            code = 1;
+                        }
+                    }
+                };
+                put(index);
+                for (size_t i = 0; i < size; ++i) put(data[i]);
+                put(crc8(data, size));
+                out[code_pos] = code;
+                out.push_back(DELIMITER);
+            }
+
+            // decode one COBS frame (without delimiter) in place
+            // returns decoded size ([index][payload][crc8]) or 0 if the frame is broken
+            inline size_t decode_in_place(uint8_t* frame, const size_t size) {
+                size_t r = 0, w = 0;
+                while (r < size) {
+                    const uint8_t code = frame[r];
+                    if ((code == 0) || (r + code > size)) return 0;
+                    ++r;
+                    for (uint8_t i = 1; i < code; ++i) frame[w++] = frame[r++];
+                    if ((code != 0xFF) && (r != size)) frame[w++] = 0;
+                }
+                return w;
+            }
+
+            // verify decoded frame and return payload; false if too short or crc mismatch
+            inline bool verify(
+                const uint8_t* decoded,
+                const size_t size,
+                uint8_t& index,
+                const uint8_t*& data,
+                size_t& data_size) {
+                if (size < 2) return false;
+                index = decoded[0];
+                data = decoded + 1;
+                data_size = size - 2;
+                return crc8(data, data_size) == decoded[size - 1];
+            }
+
+            // streaming decoder which splits incoming bytes at delimiters
+            class Decoder {
+                Buffer buffer;
+                uint32_t n_errors {0};
+                bool b_overflow {false};  // bytes are skipped until the next delimiter
+
+            public:
+                // `callback(index, data, size)` is called for every valid frame
+                // frames longer than MSGPACKETIZER_MAX_DECODE_FRAME_SIZE are dropped as errors
+                template <typename F>
+                void feed(const uint8_t* data, const size_t size, F&& callback) {
+                    for (size_t i = 0; i < size; ++i) {
+                        if (data[i] != DELIMITER) {
+                            if (b_overflow) continue;
+                            if (buffer.size() >= (size_t)MSGPACKETIZER_MAX_DECODE_FRAME_SIZE) {
+                                b_overflow = true;
+                                buffer.clear();
+                                ++n_errors;
+                                continue;
+                            }
+                            buffer.push_back(data[i]);
+                            continue;
+                        }
+                        b_overflow = false;
+                        if (!buffer.empty()) {
+                            uint8_t index;
+                            const uint8_t* payload;
+                            size_t payload_size;
+                            const size_t decoded = decode_in_place(buffer.data(), buffer.size());
+                            if (verify(buffer.data(), decoded, index, payload, payload_size))
+                                callback(index, payload, payload_size);
+                            else
+                                ++n_errors;
+                        }
+                        buffer.clear();
+                    }
+                }
+
+                void reset() {
+                    buffer.clear();
+                    b_overflow = false;
+                }
+
+                // number of frames dropped because of COBS or CRC errors
+                uint32_t errors() const {
+                    return n_errors;
+                }
+
+                // bytes of the incomplete frame buffer
+                size_t bytes() const {
+                    return memory::vector_bytes(buffer);
+                }
+            };
+
+        }  // namespace codec
+
+    }  // namespace msgpacketizer
+}  // namespace msgpack
+}  // namespace arduino
+
+#endif  // HT_SERIAL_MSGPACKETIZER_CODEC_H
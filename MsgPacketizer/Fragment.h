@@ -0,0 +1,204 @@
+#pragma once
+
+#ifndef HT_SERIAL_MSGPACKETIZER_FRAGMENT_H
+#define HT_SERIAL_MSGPACKETIZER_FRAGMENT_H
+
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+// max size of one message which can be reassembled
+#ifndef MSGPACKETIZER_FRAGMENT_MAX_SIZE
+#define MSGPACKETIZER_FRAGMENT_MAX_SIZE (256 * 1024)
+#endif
+// number of messages which can be reassembled at the same time per stream
+#ifndef MSGPACKETIZER_FRAGMENT_SLOTS
+#define MSGPACKETIZER_FRAGMENT_SLOTS 4
+#endif
+#else
+#ifndef MSGPACKETIZER_FRAGMENT_MAX_SIZE
+#define MSGPACKETIZER_FRAGMENT_MAX_SIZE MSGPACK_MAX_PACKET_BYTE_SIZE
+#endif
+#ifndef MSGPACKETIZER_FRAGMENT_SLOTS
+#define MSGPACKETIZER_FRAGMENT_SLOTS 1
+#endif
+#endif
+
+namespace arduino {
+namespace msgpack {
+    namespace msgpacketizer {
+
+        // Large payloads are split into fragments sent with the same index as the message.
+        // Fragment payload is [0xC1][0x01][id][offset (u32)][total (u32)][data] (big endian).
+        // 0xC1 is never used in msgpack, so fragments and normal payloads share the index,
+        // and fragments of different messages can be interleaved on the wire.
+        // The byte after 0xC1 is the kind of extension (0x01: fragment, 0x02: latency stamp).
+        namespace fragment {
+
+            static constexpr uint8_t MARKER {0xC1};
+            static constexpr uint8_t KIND {0x01};
+            static constexpr size_t HEADER_SIZE {11};
+
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+            using Buffer = std::vector<uint8_t>;
+#else
+            using Buffer = arx::stdx::vector<uint8_t, MSGPACKETIZER_FRAGMENT_MAX_SIZE>;
+#endif
+
+            struct Header {
+                uint8_t id;
+                uint32_t offset;
+                uint32_t total;
+            };
+
+            inline bool is_fragment(const uint8_t* data, const size_t size) {
+                return (size > HEADER_SIZE) && (data[0] == MARKER) && (data[1] == KIND);
+            }
+
+            inline uint32_t read_u32(const uint8_t* p) {
+                return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+            }
+
+            template <typename B>
+            inline void write_u32(B& out, const uint32_t v) {
+                out.push_back((uint8_t)(v >> 24));
+                out.push_back((uint8_t)(v >> 16));
+                out.push_back((uint8_t)(v >> 8));
+                out.push_back((uint8_t)v);
+            }
+
+            inline Header parse(const uint8_t* data) {
+                return Header {data[2], read_u32(data + 3), read_u32(data + 7)};
+            }
+
+            // make fragment of `size` bytes from `offset` of the message into `out`
+            template <typename B>
+            inline void encode(
+                const uint8_t id,
+                const uint8_t* message,
+                const size_t total,
+                const size_t offset,
+                const size_t size,
+                B& out) {
+                out.clear();
+                out.push_back(MARKER);
+                out.push_back(KIND);
+                out.push_back(id);
+                write_u32(out, (uint32_t)offset);
+                write_u32(out, (uint32_t)total);
+                for (size_t i = 0; i < size; ++i) out.push_back(message[offset + i]);
+            }
+
+            // Fragments of a message must arrive in order (duplicates are ignored).
+            // A message with a gap, too large or evicted by newer messages is dropped.
+            class Reassembler {
+                struct Slot {
+                    bool used {false};
+                    uint8_t index {0};
+                    uint8_t id {0};
+                    uint32_t total {0};
+                    uint32_t age {0};
+                    Buffer data;
+                };
+
+                Slot slots[MSGPACKETIZER_FRAGMENT_SLOTS];
+                uint32_t n_started {0};
+                uint32_t n_dropped {0};
+
+            public:
+                // returns false if the payload is not a fragment
+                // `callback(index, data, size)` is called when the last fragment of a message arrives
+                template <typename F>
+                bool feed(const uint8_t index, const uint8_t* data, const size_t size, F&& callback) {
+                    if (!is_fragment(data, size)) return false;
+                    const Header h = parse(data);
+                    const uint8_t* chunk = data + HEADER_SIZE;
+                    const size_t n = size - HEADER_SIZE;
+                    Slot* s = find(index, h.id);
+                    if ((h.total > MSGPACKETIZER_FRAGMENT_MAX_SIZE) || ((size_t)h.offset + n > h.total)) {
+                        if (h.offset == 0) {
+                            LOG_WARN(F("message is too large to reassemble: index ="), index, F("size ="), h.total);
+                            ++n_dropped;
+                        }
+                        drop(s);
+                        return true;
+                    }
+                    if ((h.offset == 0) && !(s && (s->total == h.total))) {
+                        drop(s);  // stale message of the same id
+                        s = allocate(index, h.id, h.total);
+                    } else if (!s || (s->total != h.total) || (h.offset > s->data.size())) {
+                        drop(s);  // lost fragment
+                        return true;
+                    } else if (h.offset < s->data.size()) {
+                        return true;  // duplicate
+                    }
+                    for (size_t i = 0; i < n; ++i) s->data.push_back(chunk[i]);
+                    if (s->data.size() == s->total) {
+                        callback(index, s->data.data(), s->data.size());
+                        release(s);
+                    }
+                    return true;
+                }
+
+                // number of messages which could not be reassembled
+                uint32_t dropped() const {
+                    return n_dropped;
+                }
+
+                // bytes of reassembly buffers
+                size_t bytes() const {
+                    size_t n = 0;
+                    for (auto& s : slots) n += memory::vector_bytes(s.data);
+                    return n;
+                }
+
+            private:
+                Slot* find(const uint8_t index, const uint8_t id) {
+                    for (auto& s : slots)
+                        if (s.used && (s.index == index) && (s.id == id)) return &s;
+                    return nullptr;
+                }
+
+                // use free slot or evict the oldest one
+                Slot* allocate(const uint8_t index, const uint8_t id, const uint32_t total) {
+                    Slot* s = &slots[0];
+                    for (auto& c : slots) {
+                        if (!c.used) {
+                            s = &c;
+                            break;
+                        }
+                        if (c.age < s->age) s = &c;
+                    }
+                    if (s->used) drop(s);
+                    s->used = true;
+                    s->index = index;
+                    s->id = id;
+                    s->total = total;
+                    s->age = n_started++;
+                    s->data.clear();
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+                    s->data.reserve(total);
+#endif
+                    return s;
+                }
+
+                void drop(Slot* s) {
+                    if (!s) return;
+                    ++n_dropped;
+                    release(s);
+                }
+
+                void release(Slot* s) {
+                    s->used = false;
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+                    Buffer().swap(s->data);  // give memory back
+#else
+                    s->data.clear();
+#endif
+                }
+            };
+
+        }  // namespace fragment
+
+    }  // namespace msgpacketizer
+}  // namespace msgpack
+}  // namespace arduino
+
+#endif  // HT_SERIAL_MSGPACKETIZER_FRAGMENT_H
@@ -0,0 +1,288 @@
+#pragma once
+
+#ifndef HT_SERIAL_MSGPACKETIZER_LATENCY_H
+#define HT_SERIAL_MSGPACKETIZER_LATENCY_H
+
+#ifdef MSGPACKETIZER_ENABLE_STREAM
+
+namespace arduino {
+namespace msgpack {
+    namespace msgpacketizer {
+
+        // Messages to streams with latency stamp enabled are prefixed by
+        // [0xC1][0x02][flags][send_us (u32)][echo_us (u32)][hold_us (u32)] (big endian).
+        // `send_us` is MSGPACKETIZER_ELAPSED_MICROS() of the sender when the message is encoded.
+        // `echo_us` is the last `send_us` received from the peer and `hold_us` is the time since it was received,
+        // so the offset of the peer clock is estimated like NTP when stamps are sent in both directions.
+        // Stamps are exchanged per stream, and per peer address of UDP sockets.
+        namespace latency {
+
+            static constexpr uint8_t KIND {0x02};
+            static constexpr uint8_t FLAG_ECHO {0x01};
+            static constexpr size_t HEADER_SIZE {15};
+            static constexpr size_t HISTOGRAM_SIZE {16};  // log2 buckets of usec: [0, 1), [1, 2), [2, 4), ...
+            static constexpr size_t OFFSET_SAMPLES {8};   // the sample with minimum rtt of the last ones is used
+
+            struct Header {
+                uint8_t flags;
+                uint32_t send_us;
+                uint32_t echo_us;
+                uint32_t hold_us;
+            };
+
+            // UDP peer as (IPv4 address in host byte order << 16 | port), 0 for point-to-point streams
+            inline uint64_t peer(const uint32_t addr, const uint16_t port) {
+                return ((uint64_t)addr << 16) | port;
+            }
+
+            inline bool is_stamp(const uint8_t* data, const size_t size) {
+                return (size >= HEADER_SIZE) && (data[0] == fragment::MARKER) && (data[1] == KIND);
+            }
+
+            inline Header parse(const uint8_t* data) {
+                return Header {data[2], fragment::read_u32(data + 3), fragment::read_u32(data + 7),
+                               fragment::read_u32(data + 11)};
+            }
+
+            template <typename B>
+            inline void encode(const Header& h, B& out) {
+                out.push_back(fragment::MARKER);
+                out.push_back(KIND);
+                out.push_back(h.flags);
+                fragment::write_u32(out, h.send_us);
+                fragment::write_u32(out, h.echo_us);
+                fragment::write_u32(out, h.hold_us);
+            }
+
+            // latency of received messages of one index in usec
+            struct Distribution {
+                uint32_t count {0};
+                uint32_t last_us {0};
+                uint32_t min_us {UINT32_MAX};
+                uint32_t max_us {0};
+                uint64_t sum_us {0};
+                uint32_t histogram[HISTOGRAM_SIZE] {};
+
+                void add(const uint32_t us) {
+                    ++count;
+                    last_us = us;
+                    if (us < min_us) min_us = us;
+                    if (us > max_us) max_us = us;
+                    sum_us += us;
+                    size_t b = 0;
+                    for (uint32_t v = us; v && (b < HISTOGRAM_SIZE - 1); v >>= 1) ++b;
+                    ++histogram[b];
+                }
+
+                void merge(const Distribution& d) {
+                    if (!d.count) return;
+                    last_us = d.last_us;
+                    count += d.count;
+                    if (d.min_us < min_us) min_us = d.min_us;
+                    if (d.max_us > max_us) max_us = d.max_us;
+                    sum_us += d.sum_us;
+                    for (size_t b = 0; b < HISTOGRAM_SIZE; ++b) histogram[b] += d.histogram[b];
+                }
+
+                uint32_t mean() const {
+                    return count ? (uint32_t)(sum_us / count) : 0;
+                }
+
+                // upper bound of the bucket which contains `p` (0.0 - 1.0) of messages, e.g. 0.99 for p99
+                uint32_t percentile(const float p) const {
+                    if (!count) return 0;
+                    const uint32_t target = (uint32_t)(p * (float)count + 0.5f);
+                    uint32_t n = 0;
+                    for (size_t b = 0; b < HISTOGRAM_SIZE - 1; ++b) {
+                        n += histogram[b];
+                        if (n >= target) return ((uint32_t)1 << b) < max_us ? ((uint32_t)1 << b) : max_us;
+                    }
+                    return max_us;
+                }
+            };
+
+            // offset of the peer clock from the local clock (peer - local)
+            struct ClockOffset {
+                bool valid {false};
+                int32_t offset_us {0};
+                uint32_t rtt_us {0};
+            };
+
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+            using DistributionMap = std::map<uint8_t, Distribution>;
+#else
+            using DistributionMap = arx::stdx::map<uint8_t, Distribution, PACKETIZER_MAX_CALLBACK_QUEUE_SIZE>;
+#endif
+
+            // stamps exchanged with one peer of a stream
+            class Link {
+                bool b_peer {false};
+                uint32_t peer_send_us {0};
+                uint32_t peer_recv_us {0};
+                ClockOffset samples[OFFSET_SAMPLES];
+                size_t n_samples {0};
+
+            public:
+                DistributionMap indices;
+
+                Header stamp(const uint32_t now) const {
+                    Header h {0, now, 0, 0};
+                    if (b_peer) {
+                        h.flags |= FLAG_ECHO;
+                        h.echo_us = peer_send_us;
+                        h.hold_us = now - peer_recv_us;
+                    }
+                    return h;
+                }
+
+                void receive(const uint8_t index, const Header& h, const uint32_t now) {
+                    if (h.flags & FLAG_ECHO) {
+                        // t1 = echo_us (local), t2 = send_us - hold_us (peer), t3 = send_us (peer), t4 = now (local)
+                        const int32_t rtt = (int32_t)(now - h.echo_us) - (int32_t)h.hold_us;
+                        if (rtt >= 0) {
+                            ClockOffset& s = samples[n_samples++ % OFFSET_SAMPLES];
+                            s.valid = true;
+                            s.rtt_us = (uint32_t)rtt;
+                            const int32_t t2_t1 = (int32_t)(h.send_us - h.hold_us - h.echo_us);
+                            s.offset_us = (t2_t1 + (int32_t)(h.send_us - now)) / 2;
+                        }
+                    }
+                    b_peer = true;
+                    peer_send_us = h.send_us;
+                    peer_recv_us = now;
+
+                    // sent time in local clock is send_us - offset
+                    const ClockOffset o = offset();
+                    const int32_t us = (int32_t)(now - h.send_us) + (o.valid ? o.offset_us : 0);
+                    indices[index].add((us > 0) ? (uint32_t)us : 0);
+                }
+
+                ClockOffset offset() const {
+                    ClockOffset best;
+                    for (auto& s : samples)
+                        if (s.valid && (!best.valid || (s.rtt_us < best.rtt_us))) best = s;
+                    return best;
+                }
+
+                void reset() {
+                    indices.clear();
+                }
+            };
+
+            struct LinkKey {
+                const void* stream;
+                uint64_t peer;
+
+                bool operator<(const LinkKey& rhs) const {
+                    return (stream != rhs.stream) ? (stream < rhs.stream) : (peer < rhs.peer);
+                }
+            };
+
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+            using LinkMap = std::map<LinkKey, Link>;
+#else
+            using LinkMap = arx::stdx::map<LinkKey, Link, PACKETIZER_MAX_STREAM_MAP_SIZE>;
+#endif
+
+            // links are shared by the publisher (stamp) and the receiver (echo) of the same stream and peer
+            class Registry {
+                Registry() {}
+                Registry(const Registry&) = delete;
+                Registry& operator=(const Registry&) = delete;
+
+                LinkMap links;
+                detail::Mutex mtx;
+
+            public:
+                static Registry& getInstance() {
+                    static Registry r;
+                    return r;
+                }
+
+                // append stamp of the stream to the peer to `out`
+                template <typename B>
+                void stamp(const void* stream, const uint64_t peer, B& out) {
+                    detail::LockGuard lock(mtx);
+                    encode(links[LinkKey {stream, peer}].stamp(MSGPACKETIZER_ELAPSED_MICROS()), out);
+                }
+
+                void receive(const void* stream, const uint64_t peer, const uint8_t index, const uint8_t* data) {
+                    const uint32_t now = MSGPACKETIZER_ELAPSED_MICROS();
+                    detail::LockGuard lock(mtx);
+                    links[LinkKey {stream, peer}].receive(index, parse(data), now);
+                }
+
+                // latency from all peers of the stream
+                Distribution distribution(const void* stream, const uint8_t index) {
+                    detail::LockGuard lock(mtx);
+                    Distribution sum;
+                    for (auto& l : links) {
+                        if (l.first.stream != stream) continue;
+                        auto d = l.second.indices.find(index);
+                        if (d != l.second.indices.end()) sum.merge(d->second);
+                    }
+                    return sum;
+                }
+
+                Distribution distribution(const void* stream, const uint64_t peer, const uint8_t index) {
+                    detail::LockGuard lock(mtx);
+                    auto it = links.find(LinkKey {stream, peer});
+                    if (it == links.end()) return Distribution();
+                    auto d = it->second.indices.find(index);
+                    return (d == it->second.indices.end()) ? Distribution() : d->second;
+                }
+
+                // clock offset of the only peer of the stream, invalid if stamps come from several peers
+                ClockOffset offset(const void* stream) {
+                    detail::LockGuard lock(mtx);
+                    const Link* link = nullptr;
+                    for (auto& l : links) {
+                        if (l.first.stream != stream) continue;
+                        if (link) return ClockOffset();
+                        link = &l.second;
+                    }
+                    return link ? link->offset() : ClockOffset();
+                }
+
+                ClockOffset offset(const void* stream, const uint64_t peer) {
+                    detail::LockGuard lock(mtx);
+                    auto it = links.find(LinkKey {stream, peer});
+                    return (it == links.end()) ? ClockOffset() : it->second.offset();
+                }
+
+                // latency of all peers of the stream is cleared
+                void reset(const void* stream) {
+                    detail::LockGuard lock(mtx);
+                    for (auto& l : links)
+                        if (l.first.stream == stream) l.second.reset();
+                }
+            };
+
+        }  // namespace latency
+
+        // latency of messages received from the stream with the index (only stamped messages are counted)
+        // messages from all peers of a UDP socket are counted, see the overload with ip and port for one peer
+        template <typename S>
+        inline latency::Distribution getLatency(const S& stream, const uint8_t index) {
+            return latency::Registry::getInstance().distribution(&stream, index);
+        }
+
+        // clock offset of the peer estimated from stamps in both directions
+        // (invalid for UDP sockets which receive stamps from several peers, see the overload with ip and port)
+        template <typename S>
+        inline latency::ClockOffset getClockOffset(const S& stream) {
+            return latency::Registry::getInstance().offset(&stream);
+        }
+
+        template <typename S>
+        inline void resetLatency(const S& stream) {
+            latency::Registry::getInstance().reset(&stream);
+        }
+
+    }  // namespace msgpacketizer
+}  // namespace msgpack
+}  // namespace arduino
+
+#endif  // MSGPACKETIZER_ENABLE_STREAM
+
+#endif  // HT_SERIAL_MSGPACKETIZER_LATENCY_H
@@ -0,0 +1,183 @@
+#pragma once
+
+#ifndef HT_SERIAL_MSGPACKETIZER_MEMORY_H
+#define HT_SERIAL_MSGPACKETIZER_MEMORY_H
+
+namespace arduino {
+namespace msgpack {
+    namespace msgpacketizer {
+
+        // Bytes held by PackerManager, UnpackerManager and receivers of streams.
+        // Containers are estimated from their elements (and node / control block overhead of the standard library),
+        // so values are close to heap usage on hosts. On NO-STL boards, containers have fixed capacity,
+        // and values are the bytes of used elements to be compared with the capacity macros.
+        namespace memory {
+
+            static constexpr size_t NODE_OVERHEAD {4 * sizeof(void*)};  // std::map node (3 links + color)
+            static constexpr size_t REF_OVERHEAD {3 * sizeof(void*)};   // std::shared_ptr control block
+
+            template <typename C>
+            inline size_t vector_bytes(const C& c) {
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+                return c.capacity() * sizeof(typename C::value_type);
+#else
+                return c.size() * sizeof(typename C::value_type);
+#endif
+            }
+
+            template <typename C>
+            inline size_t map_bytes(const C& c) {
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+                return c.size() * (sizeof(typename C::value_type) + NODE_OVERHEAD);
+#else
+                return c.size() * sizeof(typename C::value_type);
+#endif
+            }
+
+#ifdef MSGPACKETIZER_ENABLE_MEMORY_STATS
+
+            struct Usage {
+                size_t live {0};
+                size_t peak {0};  // max of live bytes when sampled
+
+                void add(const size_t bytes) {
+                    live += bytes;
+                }
+                void commit() {
+                    if (live > peak) peak = live;
+                }
+            };
+
+            struct IndexFootprint {
+                Usage publisher;           // published element and its destination
+                Usage subscriber;          // subscribed callback
+                size_t max_tx_frame {0};  // largest frame sent (bytes on the wire)
+                size_t max_rx_frame {0};  // largest frame received (estimated from decoded payload)
+            };
+
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+            using IndexFootprintMap = std::map<uint8_t, IndexFootprint>;
+#else
+            using IndexFootprintMap = arx::stdx::map<uint8_t, IndexFootprint, PACKETIZER_MAX_CALLBACK_QUEUE_SIZE>;
+#endif
+
+            struct StreamFootprint {
+                Usage publishers;  // destinations and elements published to the stream
+                Usage outbound;    // outbound queue, fragments being sent and cached constant frames
+                Usage receiver;    // subscribers, taps, reassembly and decoder buffers
+                Usage unpacker;    // unpacker of the stream
+                IndexFootprintMap indices;
+            };
+
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+            using StreamFootprintMap = std::map<const void*, StreamFootprint>;
+#else
+            using StreamFootprintMap = arx::stdx::map<const void*, StreamFootprint, PACKETIZER_MAX_STREAM_MAP_SIZE>;
+#endif
+
+            struct Footprint {
+                Usage packer;    // encoder and containers of PackerManager which are not per stream
+                Usage unpacker;  // decoder for manual feed() and containers of UnpackerManager
+                Usage total;
+                StreamFootprintMap streams;
+            };
+
+            // Usage owned by PackerManager (publisher side) or UnpackerManager (subscriber side)
+            enum class Side : uint8_t { PUBLISHER, SUBSCRIBER };
+
+            class Registry {
+                Registry() {}
+                Registry(const Registry&) = delete;
+                Registry& operator=(const Registry&) = delete;
+
+                Footprint fp;
+                detail::Mutex mtx;
+
+            public:
+                static Registry& getInstance() {
+                    static Registry r;
+                    return r;
+                }
+
+                void sent(const void* stream, const uint8_t index, const size_t frame_size) {
+                    detail::LockGuard lock(mtx);
+                    IndexFootprint& i = fp.streams[stream].indices[index];
+                    if (frame_size > i.max_tx_frame) i.max_tx_frame = frame_size;
+                }
+
+                void received(const void* stream, const uint8_t index, const size_t frame_size) {
+                    detail::LockGuard lock(mtx);
+                    IndexFootprint& i = fp.streams[stream].indices[index];
+                    if (frame_size > i.max_rx_frame) i.max_rx_frame = frame_size;
+                }
+
+                // live bytes of the side are counted again by `collect(footprint)` and peaks are updated
+                // `collect` runs without the lock because sent() and received() are called with other locks held
+                template <typename F>
+                void sample(const Side side, F&& collect) {
+                    Footprint counted;
+                    collect(counted);
+
+                    detail::LockGuard lock(mtx);
+                    const bool b_pub = (side == Side::PUBLISHER);
+                    (b_pub ? fp.packer : fp.unpacker).live = (b_pub ? counted.packer : counted.unpacker).live;
+                    for (auto& s : fp.streams) {
+                        StreamFootprint& sf = s.second;
+                        if (b_pub) {
+                            sf.publishers.live = sf.outbound.live = 0;
+                        } else {
+                            sf.receiver.live = sf.unpacker.live = 0;
+                        }
+                        for (auto& i : sf.indices) (b_pub ? i.second.publisher : i.second.subscriber).live = 0;
+                    }
+                    for (auto& s : counted.streams) {
+                        StreamFootprint& sf = fp.streams[s.first];
+                        sf.publishers.add(s.second.publishers.live);
+                        sf.outbound.add(s.second.outbound.live);
+                        sf.receiver.add(s.second.receiver.live);
+                        sf.unpacker.add(s.second.unpacker.live);
+                        for (auto& i : s.second.indices) {
+                            IndexFootprint& f = sf.indices[i.first];
+                            f.publisher.add(i.second.publisher.live);
+                            f.subscriber.add(i.second.subscriber.live);
+                        }
+                    }
+
+                    fp.total.live = fp.packer.live + fp.unpacker.live;
+                    fp.packer.commit();
+                    fp.unpacker.commit();
+                    for (auto& s : fp.streams) {
+                        StreamFootprint& sf = s.second;
+                        sf.publishers.commit();
+                        sf.outbound.commit();
+                        sf.receiver.commit();
+                        sf.unpacker.commit();
+                        fp.total.live += sf.publishers.live + sf.outbound.live + sf.receiver.live + sf.unpacker.live;
+                        for (auto& i : sf.indices) {
+                            i.second.publisher.commit();
+                            i.second.subscriber.commit();
+                        }
+                    }
+                    fp.total.commit();
+                }
+
+                Footprint get() {
+                    detail::LockGuard lock(mtx);
+                    return fp;
+                }
+
+                void reset() {
+                    detail::LockGuard lock(mtx);
+                    fp = Footprint();
+                }
+            };
+
+#endif  // MSGPACKETIZER_ENABLE_MEMORY_STATS
+
+        }  // namespace memory
+
+    }  // namespace msgpacketizer
+}  // namespace msgpack
+}  // namespace arduino
+
+#endif  // HT_SERIAL_MSGPACKETIZER_MEMORY_H
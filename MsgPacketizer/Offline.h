@@ -0,0 +1,290 @@
+#pragma once
+
+#ifndef HT_SERIAL_MSGPACKETIZER_OFFLINE_H
+#define HT_SERIAL_MSGPACKETIZER_OFFLINE_H
+
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+
+namespace arduino {
+namespace msgpack {
+    namespace msgpacketizer {
+
+        // Batch decoder for recorded raw byte streams (COBS frames split by 0x00).
+        // The input is split at delimiters into one chunk per thread, and every chunk is
+        // COBS decoded in place and CRC checked in parallel. Results are grouped by index in stream order.
+        // Files are decoded in their private mapping, and other input is copied once into the result.
+        namespace offline {
+
+            struct Payload {
+                const uint8_t* data;
+                size_t size;
+            };
+
+            // all frames of one index
+            struct Column {
+                std::vector<uint64_t> sequence;  // frame number in the whole stream
+                std::vector<Payload> payloads;
+            };
+
+            class Result;
+
+            namespace detail {
+                // private copy-on-write mapping of a file, frames are decoded in place in it
+                class Mapping {
+                    void* addr {nullptr};
+                    size_t size {0};
+
+                public:
+                    Mapping() {}
+                    Mapping(void* addr, const size_t size) : addr(addr), size(size) {}
+                    Mapping(Mapping&& m) : addr(m.addr), size(m.size) {
+                        m.addr = nullptr;
+                    }
+                    Mapping& operator=(Mapping&& m) {
+                        if (this != &m) {
+                            if (addr) ::munmap(addr, size);
+                            addr = m.addr;
+                            size = m.size;
+                            m.addr = nullptr;
+                        }
+                        return *this;
+                    }
+                    Mapping(const Mapping&) = delete;
+                    Mapping& operator=(const Mapping&) = delete;
+                    ~Mapping() {
+                        if (addr) ::munmap(addr, size);
+                    }
+                };
+
+                inline void decode_in_place(uint8_t* data, const size_t size, size_t n_threads, Result& result);
+            }  // namespace detail
+
+            class Result {
+                codec::Buffer buffer;     // copy of the input of decode(), frames are decoded in place
+                detail::Mapping mapping;  // or the file of decode_file()
+                std::map<uint8_t, Column> columns;
+                uint64_t n_frames {0};
+                uint64_t n_errors {0};
+
+                friend Result decode(const uint8_t* data, const size_t size, size_t n_threads);
+                friend Result decode_file(const char* path, const size_t n_threads);
+                friend void detail::decode_in_place(uint8_t* data, const size_t size, size_t n_threads, Result& result);
+
+            public:
+                // payloads point to the buffers of this object, so it can be moved but not copied
+                Result() {}
+                Result(Result&&) = default;
+                Result& operator=(Result&&) = default;
+                Result(const Result&) = delete;
+                Result& operator=(const Result&) = delete;
+
+                const std::map<uint8_t, Column>& getColumns() const {
+                    return columns;
+                }
+
+                const Column* getColumn(const uint8_t index) const {
+                    auto it = columns.find(index);
+                    return (it == columns.end()) ? nullptr : &it->second;
+                }
+
+                uint64_t frames() const {
+                    return n_frames;
+                }
+
+                // frames dropped because of COBS or CRC errors
+                uint64_t errors() const {
+                    return n_errors;
+                }
+
+                // deserialize payloads of the index in parallel into one array per field
+                // payloads which cannot be deserialized into Ts... are skipped and counted to `n_skipped`
+                template <typename... Ts>
+                std::tuple<std::vector<Ts>...> unpack(
+                    const uint8_t index, size_t n_threads = 0, uint64_t* n_skipped = nullptr) const {
+                    if (n_skipped) *n_skipped = 0;
+                    std::tuple<std::vector<Ts>...> out;
+                    const Column* column = getColumn(index);
+                    if (!column) return out;
+                    const size_t n = column->payloads.size();
+                    if (n_threads == 0) n_threads = std::thread::hardware_concurrency();
+                    if (n_threads == 0) n_threads = 1;
+                    if (n_threads > n) n_threads = n ? n : 1;
+
+                    std::vector<std::tuple<std::vector<Ts>...>> parts(n_threads);
+                    std::vector<uint64_t> skipped(n_threads, 0);
+                    std::vector<std::thread> threads;
+                    for (size_t t = 0; t < n_threads; ++t) {
+                        threads.emplace_back([&, t] {
+                            MsgPack::Unpacker unpacker;
+                            std::tuple<Ts...> values;
+                            const size_t begin = n * t / n_threads;
+                            const size_t end = n * (t + 1) / n_threads;
+                            reserve(parts[t], end - begin, std::index_sequence_for<Ts...> {});
+                            for (size_t i = begin; i < end; ++i) {
+                                const Payload& p = column->payloads[i];
+                                unpacker.clear();
+                                unpacker.feed(p.data, p.size);
+                                if (unpacker.to_tuple(values))
+                                    append(parts[t], values, std::index_sequence_for<Ts...> {});
+                                else
+                                    ++skipped[t];
+                            }
+                        });
+                    }
+                    for (auto& th : threads) th.join();
+
+                    reserve(out, n, std::index_sequence_for<Ts...> {});
+                    for (auto& part : parts) merge(out, part, std::index_sequence_for<Ts...> {});
+                    if (n_skipped) {
+                        for (const auto& k : skipped) *n_skipped += k;
+                    }
+                    return out;
+                }
+
+            private:
+                template <typename... Ts, size_t... Is>
+                static void reserve(std::tuple<std::vector<Ts>...>& cols, const size_t n, std::index_sequence<Is...>) {
+                    (void)std::initializer_list<int> {(std::get<Is>(cols).reserve(n), 0)...};
+                }
+
+                template <typename... Ts, size_t... Is>
+                static void append(
+                    std::tuple<std::vector<Ts>...>& cols, const std::tuple<Ts...>& values, std::index_sequence<Is...>) {
+                    (void)std::initializer_list<int> {(std::get<Is>(cols).push_back(std::get<Is>(values)), 0)...};
+                }
+
+                template <typename... Ts, size_t... Is>
+                static void merge(
+                    std::tuple<std::vector<Ts>...>& cols,
+                    std::tuple<std::vector<Ts>...>& part,
+                    std::index_sequence<Is...>) {
+                    (void)std::initializer_list<int> {(std::get<Is>(cols).insert(
+                                                           std::get<Is>(cols).end(),
+                                                           std::make_move_iterator(std::get<Is>(part).begin()),
+                                                           std::make_move_iterator(std::get<Is>(part).end())),
+                                                       0)...};
+                }
+            };
+
+            namespace detail {
+                struct Chunk {
+                    uint8_t* begin;
+                    uint8_t* end;
+                    Column columns[256];  // sequence is the frame number in the chunk
+                    uint64_t n_frames {0};
+                    uint64_t n_errors {0};
+                };
+
+                // COBS decoded payload is never longer than its frame, so frames are decoded where they are
+                inline void decode_chunk(Chunk& c) {
+                    uint8_t* p = c.begin;
+                    while (p < c.end) {
+                        uint8_t* delim = (uint8_t*)std::memchr(p, codec::DELIMITER, (size_t)(c.end - p));
+                        if (!delim) delim = c.end;  // last frame without delimiter
+                        const size_t len = (size_t)(delim - p);
+                        if (len) {
+                            const size_t decoded = codec::decode_in_place(p, len);
+                            uint8_t index;
+                            const uint8_t* payload;
+                            size_t payload_size;
+                            if (codec::verify(p, decoded, index, payload, payload_size)) {
+                                Column& column = c.columns[index];
+                                column.sequence.push_back(c.n_frames++);
+                                column.payloads.push_back(Payload {payload, payload_size});
+                            } else {
+                                ++c.n_errors;
+                            }
+                        }
+                        p = delim + 1;
+                    }
+                }
+
+                // columns are built per chunk on worker threads and merged by index in stream order
+                inline void decode_in_place(uint8_t* data, const size_t size, size_t n_threads, Result& result) {
+                    if (n_threads == 0) n_threads = std::thread::hardware_concurrency();
+                    if (n_threads == 0) n_threads = 1;
+
+                    // split at delimiters so that no frame is shared by two chunks
+                    std::vector<Chunk> chunks(n_threads);
+                    uint8_t* const end = data + size;
+                    uint8_t* begin = data;
+                    size_t n_chunks = 0;
+                    for (size_t t = 1; (t <= n_threads) && (begin < end); ++t) {
+                        uint8_t* split = (t == n_threads) ? end : data + size * t / n_threads;
+                        if (split < begin) split = begin;
+                        uint8_t* delim = (uint8_t*)std::memchr(split, codec::DELIMITER, (size_t)(end - split));
+                        split = delim ? delim + 1 : end;
+                        chunks[n_chunks].begin = begin;
+                        chunks[n_chunks].end = split;
+                        ++n_chunks;
+                        begin = split;
+                    }
+
+                    std::vector<std::thread> threads;
+                    for (size_t i = 0; i < n_chunks; ++i)
+                        threads.emplace_back([&chunks, i] { decode_chunk(chunks[i]); });
+                    for (auto& th : threads) th.join();
+
+                    for (size_t i = 0; i < n_chunks; ++i) {
+                        Chunk& c = chunks[i];
+                        for (size_t index = 0; index < 256; ++index) {
+                            Column& src = c.columns[index];
+                            if (src.payloads.empty()) continue;
+                            Column& dst = result.columns[(uint8_t)index];
+                            if (dst.payloads.empty()) {
+                                for (auto& seq : src.sequence) seq += result.n_frames;
+                                dst = std::move(src);
+                                continue;
+                            }
+                            for (const auto& seq : src.sequence) dst.sequence.push_back(seq + result.n_frames);
+                            dst.payloads.insert(dst.payloads.end(), src.payloads.begin(), src.payloads.end());
+                        }
+                        result.n_frames += c.n_frames;
+                        result.n_errors += c.n_errors;
+                    }
+                }
+            }  // namespace detail
+
+            // decode whole byte stream with `n_threads` (0: number of cores)
+            // the input is copied once into the result and decoded in place there
+            inline Result decode(const uint8_t* data, const size_t size, size_t n_threads = 0) {
+                Result result;
+                result.buffer.assign(data, data + size);
+                detail::decode_in_place(result.buffer.data(), size, n_threads, result);
+                return result;
+            }
+
+            // decode raw byte stream recorded in the file (mapped with mmap)
+            inline Result decode_file(const char* path, const size_t n_threads = 0) {
+                const int fd = ::open(path, O_RDONLY);
+                if (fd < 0) {
+                    LOG_ERROR(F("cannot open file: "), path);
+                    return Result();
+                }
+                struct stat st;
+                if ((::fstat(fd, &st) < 0) || (st.st_size == 0)) {
+                    ::close(fd);
+                    return Result();
+                }
+                // private mapping: pages are copied only when frames in them are decoded, the file is not changed
+                void* addr = ::mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+                ::close(fd);
+                if (addr == MAP_FAILED) {
+                    LOG_ERROR(F("cannot map file: "), path);
+                    return Result();
+                }
+                Result result;
+                result.mapping = detail::Mapping(addr, (size_t)st.st_size);
+                detail::decode_in_place(reinterpret_cast<uint8_t*>(addr), (size_t)st.st_size, n_threads, result);
+                return result;
+            }
+
+        }  // namespace offline
+
+    }  // namespace msgpacketizer
+}  // namespace msgpack
+}  // namespace arduino
+
+#endif  // MSGPACKETIZER_ENABLE_POSIX
+
+#endif  // HT_SERIAL_MSGPACKETIZER_OFFLINE_H
@@ -0,0 +1,178 @@
+#pragma once
+
+#ifndef HT_SERIAL_MSGPACKETIZER_POOL_H
+#define HT_SERIAL_MSGPACKETIZER_POOL_H
+
+// number of decode storages kept by every subscription (0: construct them on stack for every packet)
+#ifndef MSGPACKETIZER_DECODE_POOL_SIZE
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+#define MSGPACKETIZER_DECODE_POOL_SIZE 1
+#else
+#define MSGPACKETIZER_DECODE_POOL_SIZE 0
+#endif
+#endif
+
+namespace arduino {
+namespace msgpack {
+    namespace msgpacketizer {
+
+        namespace detail {
+            // called when decode storage is returned to the pool
+            // containers are cleared but keep their capacity to be refilled by the next packet
+            // other values are reset to default so that nothing leaks into the next packet
+            template <typename T>
+            inline auto reset_impl(T& t, int) -> decltype(t.clear(), void()) {
+                t.clear();
+            }
+            template <typename T>
+            inline auto reset_impl(T& t, long) -> decltype(t = T {}, void()) {
+                t = T {};
+            }
+            template <typename T>
+            inline void reset_impl(T&, ...) {}
+
+            template <typename T>
+            inline void reset(T& t) {
+                reset_impl(t, 0);
+            }
+
+            template <size_t I = 0, typename... Ts>
+            inline auto reset_tuple(std::tuple<Ts...>&) -> std::enable_if_t<(I == sizeof...(Ts))> {}
+            template <size_t I = 0, typename... Ts>
+            inline auto reset_tuple(std::tuple<Ts...>& t) -> std::enable_if_t<(I < sizeof...(Ts))> {
+                reset(std::get<I>(t));
+                reset_tuple<I + 1>(t);
+            }
+
+            template <typename... Ts>
+            inline void reset(std::tuple<Ts...>& t) {
+                reset_tuple(t);
+            }
+        }  // namespace detail
+
+        // per-subscription free list of decode storage which is reused across packets
+        // storage is reset after every callback and returned to the pool
+        template <typename T, size_t N = MSGPACKETIZER_DECODE_POOL_SIZE>
+        class Pool {
+            T* objects[N];
+            size_t n_free {0};
+
+            // returns storage to the pool even if the callback throws
+            struct Lease {
+                Pool& pool;
+                T* t;
+                ~Lease() {
+                    detail::reset(*t);
+                    pool.release(t);
+                }
+            };
+
+            void release(T* t) {
+                if (n_free < N)
+                    objects[n_free++] = t;
+                else
+                    delete t;
+            }
+
+        public:
+            Pool() {}
+            Pool(const Pool&) = delete;
+            Pool& operator=(const Pool&) = delete;
+            ~Pool() {
+                while (n_free) delete objects[--n_free];
+            }
+
+            template <typename F>
+            void use(F&& func) {
+                Lease lease {*this, n_free ? objects[--n_free] : new T()};
+                func(*lease.t);
+            }
+
+            size_t available() const {
+                return n_free;
+            }
+        };
+
+        // pooling disabled: storage is constructed on stack for every packet
+        template <typename T>
+        class Pool<T, 0> {
+        public:
+            template <typename F>
+            void use(F&& func) {
+                T t;
+                func(t);
+            }
+
+            size_t available() const {
+                return 0;
+            }
+        };
+
+        template <typename T>
+        using PoolRef = std::shared_ptr<Pool<T>>;
+
+#ifdef ARDUINOJSON_VERSION
+
+        // DynamicJsonDocument is kept with the largest capacity required so far
+        template <size_t N = MSGPACKETIZER_DECODE_POOL_SIZE>
+        class DynamicJsonDocumentPool {
+            DynamicJsonDocument* docs[N];
+            size_t n_free {0};
+
+            // returns document to the pool even if the callback throws
+            struct Lease {
+                DynamicJsonDocumentPool& pool;
+                DynamicJsonDocument* doc;
+                ~Lease() {
+                    doc->clear();
+                    pool.release(doc);
+                }
+            };
+
+            void release(DynamicJsonDocument* doc) {
+                if (n_free < N)
+                    docs[n_free++] = doc;
+                else
+                    delete doc;
+            }
+
+        public:
+            DynamicJsonDocumentPool() {}
+            DynamicJsonDocumentPool(const DynamicJsonDocumentPool&) = delete;
+            DynamicJsonDocumentPool& operator=(const DynamicJsonDocumentPool&) = delete;
+            ~DynamicJsonDocumentPool() {
+                while (n_free) delete docs[--n_free];
+            }
+
+            template <typename F>
+            void use(const size_t capacity, F&& func) {
+                DynamicJsonDocument* doc = n_free ? docs[--n_free] : nullptr;
+                if (doc && (doc->capacity() < capacity)) {
+                    delete doc;
+                    doc = nullptr;
+                }
+                if (!doc) doc = new DynamicJsonDocument(capacity);
+                Lease lease {*this, doc};
+                func(*doc);
+            }
+        };
+
+        template <>
+        class DynamicJsonDocumentPool<0> {
+        public:
+            template <typename F>
+            void use(const size_t capacity, F&& func) {
+                DynamicJsonDocument doc(capacity);
+                func(doc);
+            }
+        };
+
+        using DynamicJsonDocumentPoolRef = std::shared_ptr<DynamicJsonDocumentPool<>>;
+
+#endif  // ARDUINOJSON_VERSION
+
+    }  // namespace msgpacketizer
+}  // namespace msgpack
+}  // namespace arduino
+
+#endif  // HT_SERIAL_MSGPACKETIZER_POOL_H
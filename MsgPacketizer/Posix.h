@@ -0,0 +1,656 @@
+#pragma once
+
+#ifndef HT_SERIAL_MSGPACKETIZER_POSIX_H
+#define HT_SERIAL_MSGPACKETIZER_POSIX_H
+
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+
+// SO_SNDBUF / SO_RCVBUF of sockets and capacity of pipes
+#ifndef MSGPACKETIZER_POSIX_BUFFER_SIZE
+#define MSGPACKETIZER_POSIX_BUFFER_SIZE (4 * 1024 * 1024)
+#endif
+// number of datagrams sent / received by one sendmmsg / recvmmsg
+#ifndef MSGPACKETIZER_POSIX_UDP_BATCH_SIZE
+#define MSGPACKETIZER_POSIX_UDP_BATCH_SIZE 32
+#endif
+// datagrams larger than this are dropped on receive
+#ifndef MSGPACKETIZER_POSIX_UDP_MAX_DATAGRAM_SIZE
+#define MSGPACKETIZER_POSIX_UDP_MAX_DATAGRAM_SIZE 9216
+#endif
+// max wait for the socket buffer to be writable in flush(), queued datagrams are dropped after that
+#ifndef MSGPACKETIZER_POSIX_UDP_SEND_TIMEOUT_MS
+#define MSGPACKETIZER_POSIX_UDP_SEND_TIMEOUT_MS 10
+#endif
+
+namespace arduino {
+namespace msgpack {
+    namespace msgpacketizer {
+
+        namespace posix {
+
+            // owns a file descriptor and closes it on destruction
+            class Socket {
+            protected:
+                int fd {-1};
+
+            public:
+                Socket() {}
+                Socket(const Socket&) = delete;
+                Socket& operator=(const Socket&) = delete;
+                virtual ~Socket() {
+                    close();
+                }
+
+                int handle() const {
+                    return fd;
+                }
+
+                bool isOpen() const {
+                    return fd >= 0;
+                }
+
+                void close() {
+                    if (fd >= 0) ::close(fd);
+                    fd = -1;
+                }
+
+                bool setNonBlocking() {
+                    const int flags = ::fcntl(fd, F_GETFL, 0);
+                    return (flags >= 0) && (::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0);
+                }
+
+                // kernel may limit the size (net.core.wmem_max / rmem_max)
+                bool setBufferSize(const int size) {
+                    return (::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) == 0)
+                        && (::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) == 0);
+                }
+
+                // local port of TCP / UDP socket (useful if it was bound to port 0)
+                uint16_t localPort() const {
+                    sockaddr_in addr;
+                    socklen_t len = sizeof(addr);
+                    if (::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len) < 0) return 0;
+                    return ntohs(addr.sin_port);
+                }
+
+            protected:
+                static bool resolve(const char* host, const uint16_t port, const int socktype, sockaddr_in& addr) {
+                    std::memset(&addr, 0, sizeof(addr));
+                    addr.sin_family = AF_INET;
+                    addr.sin_port = htons(port);
+                    if (!host || !*host) {
+                        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+                        return true;
+                    }
+                    if (::inet_pton(AF_INET, host, &addr.sin_addr) == 1) return true;
+
+                    addrinfo hints;
+                    std::memset(&hints, 0, sizeof(hints));
+                    hints.ai_family = AF_INET;
+                    hints.ai_socktype = socktype;
+                    addrinfo* res = nullptr;
+                    if ((::getaddrinfo(host, nullptr, &hints, &res) != 0) || !res) return false;
+                    addr.sin_addr = reinterpret_cast<sockaddr_in*>(res->ai_addr)->sin_addr;
+                    ::freeaddrinfo(res);
+                    return true;
+                }
+
+                static bool address(const char* path, sockaddr_un& addr) {
+                    std::memset(&addr, 0, sizeof(addr));
+                    addr.sun_family = AF_UNIX;
+                    if (std::strlen(path) >= sizeof(addr.sun_path)) {
+                        LOG_ERROR(F("unix socket path is too long: "), path);
+                        return false;
+                    }
+                    std::strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+                    return true;
+                }
+            };
+
+            // non-blocking byte stream over any file descriptor (pipe, fifo, tty, socket)
+            // which can be used like Arduino's Stream / Client
+            class Stream : public Socket {
+                codec::Buffer frame;
+                codec::Buffer tail;  // unwritten bytes of the last frame
+                uint32_t n_dropped {0};
+
+            public:
+                // take ownership of opened file descriptor
+                bool open(const int descriptor) {
+                    close();
+                    fd = descriptor;
+                    if (fd < 0) return false;
+#ifdef F_SETPIPE_SZ
+                    struct stat st;
+                    if ((::fstat(fd, &st) == 0) && S_ISFIFO(st.st_mode))
+                        ::fcntl(fd, F_SETPIPE_SZ, MSGPACKETIZER_POSIX_BUFFER_SIZE);
+#endif
+                    return setNonBlocking();
+                }
+
+                // open device or fifo (tty settings are not changed)
+                bool open(const char* path, const int flags = O_RDWR | O_NOCTTY) {
+                    const int descriptor = ::open(path, flags | O_NONBLOCK);
+                    if (descriptor < 0) {
+                        LOG_ERROR(F("cannot open "), path);
+                        return false;
+                    }
+                    return open(descriptor);
+                }
+
+                bool connected() const {
+                    return isOpen();
+                }
+
+                // closes the stream if the peer has closed it
+                int available() {
+                    int n = 0;
+                    if (!isOpen() || (::ioctl(fd, FIONREAD, &n) < 0)) return 0;
+                    if (n == 0) {
+                        pollfd p {fd, POLLIN, 0};
+                        if ((::poll(&p, 1, 0) > 0) && (p.revents & (POLLIN | POLLHUP))) close();
+                    }
+                    return n;
+                }
+
+                int read(uint8_t* buffer, const size_t size) {
+                    if (!isOpen()) return -1;
+                    const ssize_t n = ::read(fd, buffer, size);
+                    if (n > 0) return (int)n;
+                    if ((n == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))) close();
+                    return -1;
+                }
+
+                // write the frame without blocking: bytes which the descriptor does not accept now are kept
+                // and written before any other bytes, and the frame is dropped as a whole (returns 0)
+                // if the descriptor accepts nothing or the tail of the previous frame is still pending
+                size_t write(const uint8_t* data, const size_t size) {
+                    if (!flush()) {
+                        ++n_dropped;
+                        return 0;
+                    }
+                    const size_t sent = writeRaw(data, size);
+                    if (!isOpen()) return sent;
+                    if (sent == 0) {
+                        if (size) ++n_dropped;
+                        return 0;
+                    }
+                    if (sent < size) tail.assign(data + sent, data + size);
+                    return size;
+                }
+
+                // write bytes as many as the descriptor accepts without waiting
+                size_t writeSome(const uint8_t* data, const size_t size) {
+                    if (!flush()) return 0;
+                    return writeRaw(data, size);
+                }
+
+                // write the pending tail of the last frame, returns true if nothing is pending
+                bool flush() {
+                    if (tail.empty()) return true;
+                    const size_t sent = writeRaw(tail.data(), tail.size());
+                    tail.erase(tail.begin(), tail.begin() + sent);
+                    return tail.empty();
+                }
+
+                // bytes of the last frame waiting for the descriptor to be writable
+                size_t pending() const {
+                    return tail.size();
+                }
+
+                // frames dropped by write() because the descriptor was not writable
+                uint32_t dropped() const {
+                    return n_dropped;
+                }
+
+                // encode packet to frame and write it
+                size_t send(const uint8_t index, const uint8_t* data, const size_t size) {
+                    {
+                        trace::Scope scope(trace::FRAME, index);
+                        frame.clear();
+                        codec::encode(index, data, size, frame);
+                    }
+                    trace::Scope scope(trace::WRITE, index);
+                    return write(frame.data(), frame.size());
+                }
+
+                void stop() {
+                    close();
+                }
+
+                // pending bytes are discarded with the descriptor
+                void close() {
+                    Socket::close();
+                    tail.clear();
+                }
+
+            private:
+                size_t writeRaw(const uint8_t* data, const size_t size) {
+                    size_t sent = 0;
+                    while (isOpen() && (sent < size)) {
+                        const ssize_t n = ::write(fd, data + sent, size - sent);
+                        if (n > 0) {
+                            sent += (size_t)n;
+                        } else if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+                            break;
+                        } else if ((n < 0) && (errno == EINTR)) {
+                            continue;
+                        } else {
+                            close();
+                        }
+                    }
+                    return sent;
+                }
+            };
+
+            class TcpClient : public Stream {
+            public:
+                bool connect(const char* host, const uint16_t port) {
+                    close();
+                    sockaddr_in addr;
+                    if (!resolve(host, port, SOCK_STREAM, addr)) {
+                        LOG_ERROR(F("cannot resolve host: "), host);
+                        return false;
+                    }
+                    fd = ::socket(AF_INET, SOCK_STREAM, 0);
+                    if (fd < 0) return false;
+                    setBufferSize(MSGPACKETIZER_POSIX_BUFFER_SIZE);
+                    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+                        LOG_ERROR(F("cannot connect to "), host, port);
+                        close();
+                        return false;
+                    }
+                    return setup();
+                }
+
+            private:
+                friend class TcpServer;
+
+                bool setup() {
+                    const int one = 1;
+                    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    return setNonBlocking();
+                }
+            };
+
+            class TcpServer : public Socket {
+            public:
+                bool begin(const uint16_t port) {
+                    return begin(nullptr, port);
+                }
+
+                bool begin(const char* ip, const uint16_t port) {
+                    close();
+                    sockaddr_in addr;
+                    if (!resolve(ip, port, SOCK_STREAM, addr)) return false;
+                    fd = ::socket(AF_INET, SOCK_STREAM, 0);
+                    if (fd < 0) return false;
+                    const int one = 1;
+                    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+                    setBufferSize(MSGPACKETIZER_POSIX_BUFFER_SIZE);  // inherited by accepted sockets
+                    if ((::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) || (::listen(fd, 8) < 0)) {
+                        LOG_ERROR(F("cannot listen tcp port: "), port);
+                        close();
+                        return false;
+                    }
+                    return setNonBlocking();
+                }
+
+                // returns false if there is no pending connection
+                bool accept(TcpClient& client) {
+                    const int descriptor = ::accept(fd, nullptr, nullptr);
+                    if (descriptor < 0) return false;
+                    return client.open(descriptor) && client.setup();
+                }
+            };
+
+            class UnixClient : public Stream {
+            public:
+                bool connect(const char* path) {
+                    close();
+                    sockaddr_un addr;
+                    if (!address(path, addr)) return false;
+                    fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+                    if (fd < 0) return false;
+                    setBufferSize(MSGPACKETIZER_POSIX_BUFFER_SIZE);
+                    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+                        LOG_ERROR(F("cannot connect to "), path);
+                        close();
+                        return false;
+                    }
+                    return setNonBlocking();
+                }
+            };
+
+            class UnixServer : public Socket {
+            public:
+                // existing socket file at `path` is removed
+                bool begin(const char* path) {
+                    close();
+                    sockaddr_un addr;
+                    if (!address(path, addr)) return false;
+                    ::unlink(path);
+                    fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+                    if (fd < 0) return false;
+                    setBufferSize(MSGPACKETIZER_POSIX_BUFFER_SIZE);
+                    if ((::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) || (::listen(fd, 8) < 0)) {
+                        LOG_ERROR(F("cannot listen unix socket: "), path);
+                        close();
+                        return false;
+                    }
+                    return setNonBlocking();
+                }
+
+                // returns false if there is no pending connection
+                bool accept(UnixClient& client) {
+                    const int descriptor = ::accept(fd, nullptr, nullptr);
+                    if (descriptor < 0) return false;
+                    return client.open(descriptor);
+                }
+            };
+
+            // open pipe and give its ends to `reader` and `writer`
+            inline bool make_pipe(Stream& reader, Stream& writer) {
+                int fds[2];
+                if (::pipe(fds) < 0) return false;
+                return reader.open(fds[0]) && writer.open(fds[1]);
+            }
+
+            // UDP socket which gathers frames into one sendmmsg and drains datagrams with recvmmsg
+            class UdpSocket : public Socket {
+                struct Datagram {
+                    sockaddr_in addr;
+                    size_t offset;
+                    size_t size;
+                };
+
+                codec::Buffer tx_buffer;
+                std::vector<Datagram> tx_queue;
+                codec::Buffer rx_buffer;
+                std::vector<size_t> rx_sizes;
+                std::vector<sockaddr_in> rx_addrs;
+                sockaddr_in remote {};  // sender of the datagram which was read last
+                size_t rx_count {0};
+                size_t rx_pos {0};
+                size_t rx_offset {0};
+                uint32_t n_dropped {0};
+#ifdef __linux__
+                std::vector<mmsghdr> msgs;
+                std::vector<iovec> iovs;
+#endif
+
+            public:
+                bool begin(const uint16_t port) {
+                    return begin(nullptr, port);
+                }
+
+                bool begin(const char* ip, const uint16_t port) {
+                    close();
+                    sockaddr_in addr;
+                    if (!resolve(ip, port, SOCK_DGRAM, addr)) return false;
+                    fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+                    if (fd < 0) return false;
+                    setBufferSize(MSGPACKETIZER_POSIX_BUFFER_SIZE);
+                    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+                        LOG_ERROR(F("cannot bind udp port: "), port);
+                        close();
+                        return false;
+                    }
+                    rx_buffer.resize(MSGPACKETIZER_POSIX_UDP_BATCH_SIZE * MSGPACKETIZER_POSIX_UDP_MAX_DATAGRAM_SIZE);
+                    rx_sizes.resize(MSGPACKETIZER_POSIX_UDP_BATCH_SIZE);
+                    rx_addrs.resize(MSGPACKETIZER_POSIX_UDP_BATCH_SIZE);
+                    rx_count = rx_pos = rx_offset = 0;
+                    return setNonBlocking();
+                }
+
+                void stop() {
+                    close();
+                }
+
+                // IPv4 address of the host in host byte order, 0 if it cannot be resolved
+                static uint32_t lookup(const str_t& host) {
+                    sockaddr_in addr;
+                    if (host.empty() || !resolve(host.c_str(), 0, SOCK_DGRAM, addr)) return 0;
+                    return ntohl(addr.sin_addr.s_addr);
+                }
+
+                // encode packet to frame and queue it until flush(), the host is resolved on every call
+                void queue(
+                    const str_t& ip, const uint16_t port, const uint8_t index, const uint8_t* data, const size_t size) {
+                    Datagram d;
+                    if (!resolve(ip.c_str(), port, SOCK_DGRAM, d.addr)) {
+                        LOG_ERROR(F("cannot resolve host: "), ip.c_str());
+                        return;
+                    }
+                    queue(d, index, data, size);
+                }
+
+                // IPv4 address in host byte order is used without resolving
+                void queue(
+                    const uint32_t ip,
+                    const uint16_t port,
+                    const uint8_t index,
+                    const uint8_t* data,
+                    const size_t size) {
+                    Datagram d;
+                    std::memset(&d.addr, 0, sizeof(d.addr));
+                    d.addr.sin_family = AF_INET;
+                    d.addr.sin_port = htons(port);
+                    d.addr.sin_addr.s_addr = htonl(ip);
+                    queue(d, index, data, size);
+                }
+
+                size_t queued() const {
+                    return tx_queue.size();
+                }
+
+                // send all queued frames, returns the number of datagrams sent
+                // a datagram which fails (e.g. unroutable peer or EMSGSIZE) is dropped alone and the rest are sent,
+                // and the socket is waited up to MSGPACKETIZER_POSIX_UDP_SEND_TIMEOUT_MS when its buffer is full
+                size_t flush() {
+                    trace::Scope scope(trace::WRITE, 0);
+                    const size_t n = tx_queue.size();
+                    size_t n_done = 0;
+                    size_t n_sent = 0;
+#ifdef __linux__
+                    msgs.resize(n);
+                    iovs.resize(n);
+                    for (size_t i = 0; i < n; ++i) {
+                        iovs[i].iov_base = tx_buffer.data() + tx_queue[i].offset;
+                        iovs[i].iov_len = tx_queue[i].size;
+                        std::memset(&msgs[i], 0, sizeof(mmsghdr));
+                        msgs[i].msg_hdr.msg_name = &tx_queue[i].addr;
+                        msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+                        msgs[i].msg_hdr.msg_iov = &iovs[i];
+                        msgs[i].msg_hdr.msg_iovlen = 1;
+                    }
+                    while (isOpen() && (n_done < n)) {
+                        const size_t len = ((n - n_done) < MSGPACKETIZER_POSIX_UDP_BATCH_SIZE)
+                                             ? (n - n_done)
+                                             : MSGPACKETIZER_POSIX_UDP_BATCH_SIZE;
+                        const int r = ::sendmmsg(fd, msgs.data() + n_done, (unsigned int)len, 0);
+                        if (r > 0) {
+                            n_done += (size_t)r;
+                            n_sent += (size_t)r;
+                        } else if ((r < 0) && (errno == EINTR)) {
+                            continue;
+                        } else if ((r < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+                            if (!waitWritable()) break;
+                        } else {
+                            ++n_done;  // skip only the first datagram of the batch which has failed
+                        }
+                    }
+#else
+                    while (isOpen() && (n_done < n)) {
+                        const Datagram& d = tx_queue[n_done];
+                        const ssize_t r = ::sendto(
+                            fd,
+                            tx_buffer.data() + d.offset,
+                            d.size,
+                            0,
+                            reinterpret_cast<const sockaddr*>(&d.addr),
+                            sizeof(sockaddr_in));
+                        if (r >= 0) {
+                            ++n_done;
+                            ++n_sent;
+                        } else if (errno == EINTR) {
+                            continue;
+                        } else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                            if (!waitWritable()) break;
+                        } else {
+                            ++n_done;
+                        }
+                    }
+#endif
+                    if (n_sent < n) {
+                        n_dropped += (uint32_t)(n - n_sent);
+                        LOG_WARN(F("dropped datagrams: "), n - n_sent);
+                    }
+                    tx_queue.clear();
+                    tx_buffer.clear();
+                    return n_sent;
+                }
+
+                // datagrams dropped by flush()
+                uint32_t dropped() const {
+                    return n_dropped;
+                }
+
+                // receive a batch of datagrams if the previous batch has been read
+                // returns the number of bytes which can be read
+                int parsePacket() {
+                    if (rx_pos < rx_count) return available();
+                    rx_count = rx_pos = rx_offset = 0;
+                    if (!isOpen()) return 0;
+#ifdef __linux__
+                    msgs.resize(MSGPACKETIZER_POSIX_UDP_BATCH_SIZE);
+                    iovs.resize(MSGPACKETIZER_POSIX_UDP_BATCH_SIZE);
+                    for (size_t i = 0; i < MSGPACKETIZER_POSIX_UDP_BATCH_SIZE; ++i) {
+                        iovs[i].iov_base = rx_buffer.data() + i * MSGPACKETIZER_POSIX_UDP_MAX_DATAGRAM_SIZE;
+                        iovs[i].iov_len = MSGPACKETIZER_POSIX_UDP_MAX_DATAGRAM_SIZE;
+                        std::memset(&msgs[i], 0, sizeof(mmsghdr));
+                        msgs[i].msg_hdr.msg_name = &rx_addrs[i];
+                        msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+                        msgs[i].msg_hdr.msg_iov = &iovs[i];
+                        msgs[i].msg_hdr.msg_iovlen = 1;
+                    }
+                    const int r =
+                        ::recvmmsg(fd, msgs.data(), MSGPACKETIZER_POSIX_UDP_BATCH_SIZE, MSG_DONTWAIT, nullptr);
+                    if (r <= 0) return 0;
+                    for (int i = 0; i < r; ++i) {
+                        const bool b_truncated = msgs[i].msg_hdr.msg_flags & MSG_TRUNC;
+                        if (b_truncated) LOG_WARN(F("dropped datagram larger than max datagram size"));
+                        rx_sizes[i] = b_truncated ? 0 : msgs[i].msg_len;
+                    }
+                    rx_count = (size_t)r;
+#else
+                    socklen_t len = sizeof(sockaddr_in);
+                    const ssize_t r = ::recvfrom(
+                        fd,
+                        rx_buffer.data(),
+                        MSGPACKETIZER_POSIX_UDP_MAX_DATAGRAM_SIZE,
+                        MSG_DONTWAIT,
+                        reinterpret_cast<sockaddr*>(&rx_addrs[0]),
+                        &len);
+                    if (r <= 0) return 0;
+                    rx_sizes[0] = (size_t)r;
+                    rx_count = 1;
+#endif
+                    return available();
+                }
+
+                // bytes left in the received batch
+                int available() const {
+                    size_t n = 0;
+                    for (size_t i = rx_pos; i < rx_count; ++i) n += rx_sizes[i];
+                    return (int)(n - rx_offset);
+                }
+
+                // read bytes of the received batch continuously across datagrams
+                int read(uint8_t* buffer, const size_t size) {
+                    size_t n = 0;
+                    while ((n < size) && (rx_pos < rx_count)) {
+                        const uint8_t* src = rx_buffer.data() + rx_pos * MSGPACKETIZER_POSIX_UDP_MAX_DATAGRAM_SIZE;
+                        const size_t left = rx_sizes[rx_pos] - rx_offset;
+                        const size_t len = ((size - n) < left) ? (size - n) : left;
+                        remote = rx_addrs[rx_pos];
+                        std::memcpy(buffer + n, src + rx_offset, len);
+                        n += len;
+                        rx_offset += len;
+                        if (rx_offset >= rx_sizes[rx_pos]) {
+                            ++rx_pos;
+                            rx_offset = 0;
+                        }
+                    }
+                    return (int)n;
+                }
+
+                // read bytes of the current datagram only, so that they are attributed to remoteAddr()
+                int readDatagram(uint8_t* buffer, const size_t size) {
+                    while ((rx_pos < rx_count) && (rx_offset >= rx_sizes[rx_pos])) {
+                        ++rx_pos;
+                        rx_offset = 0;
+                    }
+                    if (rx_pos >= rx_count) return 0;
+                    const size_t left = rx_sizes[rx_pos] - rx_offset;
+                    return read(buffer, (size < left) ? size : left);
+                }
+
+                // IPv4 address (host byte order) and port of the sender of the datagram which was read last
+                uint32_t remoteAddr() const {
+                    return ntohl(remote.sin_addr.s_addr);
+                }
+
+                uint16_t remotePort() const {
+                    return ntohs(remote.sin_port);
+                }
+
+            private:
+                bool waitWritable() {
+                    pollfd p {fd, POLLOUT, 0};
+                    return ::poll(&p, 1, MSGPACKETIZER_POSIX_UDP_SEND_TIMEOUT_MS) > 0;
+                }
+
+                void queue(Datagram& d, const uint8_t index, const uint8_t* data, const size_t size) {
+                    d.offset = tx_buffer.size();
+                    trace::Scope scope(trace::FRAME, index);
+                    codec::encode(index, data, size, tx_buffer);
+                    d.size = tx_buffer.size() - d.offset;
+                    tx_queue.push_back(d);
+                }
+            };
+
+        }  // namespace posix
+
+#ifdef MSGPACKETIZER_ENABLE_NETWORK
+        // hosted network backends are used through the same API as Arduino's UDP and Client
+        using UDP = posix::UdpSocket;
+        using Client = posix::TcpClient;
+#endif
+
+        namespace detail {
+            // streams which are read and written by MsgPacketizer instead of Packetizer
+            template <typename S>
+            struct is_posix_stream : std::is_base_of<posix::Socket, S> {};
+        }  // namespace detail
+
+    }  // namespace msgpacketizer
+}  // namespace msgpack
+}  // namespace arduino
+
+#else  // MSGPACKETIZER_ENABLE_POSIX
+
+namespace arduino {
+namespace msgpack {
+    namespace msgpacketizer {
+        namespace detail {
+            template <typename S>
+            struct is_posix_stream : std::false_type {};
+        }  // namespace detail
+    }  // namespace msgpacketizer
+}  // namespace msgpack
+}  // namespace arduino
+
+#endif  // MSGPACKETIZER_ENABLE_POSIX
+
+#endif  // HT_SERIAL_MSGPACKETIZER_POSIX_H
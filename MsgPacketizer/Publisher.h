@@ -3,33 +3,77 @@
 #ifndef HT_SERIAL_MSGPACKETIZER_PUBLISHER_H
 #define HT_SERIAL_MSGPACKETIZER_PUBLISHER_H
 
+// period to estimate link capacity and update adaptive intervals
+#ifndef MSGPACKETIZER_ADAPTIVE_PERIOD_USEC
+#define MSGPACKETIZER_ADAPTIVE_PERIOD_USEC 100000
+#endif
+
 namespace arduino {
 namespace msgpack {
     namespace msgpacketizer {
 
+        // order of sending in post(), and share of link budget which can be used
+        enum class Priority : uint8_t {
+            CONTROL,     // sent first, never deferred by link budget
+            NORMAL,      // deferred if link budget is not enough
+            BACKGROUND,  // deferred unless a quarter of link budget is left for others
+        };
+
         namespace element {
             struct Base {
                 uint32_t last_publish_us {0};
                 uint32_t interval_us {33333};  // 30 fps
+                Priority priority {Priority::NORMAL};
+                uint32_t min_interval_us {0};  // adaptive interval is used if max_interval_us is not 0
+                uint32_t max_interval_us {0};
+                float weight {1.f};        // share of link capacity among adaptive elements of the stream
+                uint32_t frame_bytes {0};  // size of the last frame on the wire
 
                 bool next() const {
                     return MSGPACKETIZER_ELAPSED_MICROS() >= (last_publish_us + interval_us);
                 }
+                bool adaptive() const {
+                    return max_interval_us != 0;
+                }
                 void setFrameRate(float fps) {
                     interval_us = (uint32_t)(1000000.f / fps);
+                    max_interval_us = 0;
                 }
                 void setIntervalUsec(const uint32_t us) {
                     interval_us = us;
+                    max_interval_us = 0;
                 }
                 void setIntervalMsec(const float ms) {
                     interval_us = (uint32_t)(ms * 1000.f);
+                    max_interval_us = 0;
                 }
                 void setIntervalSec(const float sec) {
                     interval_us = (uint32_t)(sec * 1000.f * 1000.f);
+                    max_interval_us = 0;
+                }
+                // interval is scaled between min and max so that publishers to the stream fit its capacity
+                void setAdaptiveIntervalUsec(const uint32_t min_us, const uint32_t max_us, const float w = 1.f) {
+                    min_interval_us = min_us ? min_us : 1;
+                    max_interval_us = (max_us > min_interval_us) ? max_us : min_interval_us;
+                    weight = (w > 0.f) ? w : 1.f;
+                    interval_us = min_interval_us;
+                }
+                void setAdaptiveFrameRate(const float max_fps, const float min_fps, const float w = 1.f) {
+                    setAdaptiveIntervalUsec((uint32_t)(1000000.f / max_fps), (uint32_t)(1000000.f / min_fps), w);
+                }
+                void setPriority(const Priority p) {
+                    priority = p;
                 }
 
                 virtual ~Base() {}
                 virtual void encodeTo(MsgPack::Packer& p) = 0;
+                // encoded bytes never change, so the frame can be cached
+                virtual bool isConst() const {
+                    return false;
+                }
+#ifdef MSGPACKETIZER_ENABLE_MEMORY_STATS
+                virtual size_t bytes() const = 0;
+#endif
             };
 
             using Ref = std::shared_ptr<Base>;
@@ -49,6 +93,11 @@ namespace msgpack {
                 virtual void encodeTo(MsgPack::Packer& p) override {
                     p.pack(t);
                 }
+#ifdef MSGPACKETIZER_ENABLE_MEMORY_STATS
+                virtual size_t bytes() const override {
+                    return sizeof(*this);
+                }
+#endif
             };
 
             template <typename T>
@@ -61,6 +110,14 @@ namespace msgpack {
                 virtual void encodeTo(MsgPack::Packer& p) override {
                     p.pack(t);
                 }
+                virtual bool isConst() const override {
+                    return true;
+                }
+#ifdef MSGPACKETIZER_ENABLE_MEMORY_STATS
+                virtual size_t bytes() const override {
+                    return sizeof(*this);
+                }
+#endif
             };
 
             template <typename T>
@@ -73,6 +130,11 @@ namespace msgpack {
                 virtual void encodeTo(MsgPack::Packer& p) override {
                     p.pack(getter());
                 }
+#ifdef MSGPACKETIZER_ENABLE_MEMORY_STATS
+                virtual size_t bytes() const override {
+                    return sizeof(*this);
+                }
+#endif
             };
 
             class Tuple : public Base {
@@ -84,6 +146,18 @@ namespace msgpack {
                 virtual void encodeTo(MsgPack::Packer& p) override {
                     for (auto& t : ts) t->encodeTo(p);
                 }
+                virtual bool isConst() const override {
+                    for (auto& t : ts)
+                        if (!t->isConst()) return false;
+                    return true;
+                }
+#ifdef MSGPACKETIZER_ENABLE_MEMORY_STATS
+                virtual size_t bytes() const override {
+                    size_t n = sizeof(*this) + memory::vector_bytes(ts);
+                    for (auto& t : ts) n += t->bytes() + memory::REF_OVERHEAD;
+                    return n;
+                }
+#endif
             };
 
         }  // namespace element
@@ -122,21 +196,23 @@ namespace msgpack {
 #ifdef MSGPACKETIZER_ENABLE_STREAM
 
         struct Destination {
-            StreamType* stream;
-            TargetStreamType type;
-            uint8_t index;
+            StreamType* stream {nullptr};
+            TargetStreamType type {TargetStreamType::STREAM_SERIAL};
+            uint8_t index {0};
             str_t ip;
-            uint16_t port;
+            uint16_t port {0};
+            uint32_t addr {0};  // ip resolved once as IPv4 in host byte order (0: unresolved, compared by string)
 
             Destination() {}
             Destination(const Destination& dest)
-            : stream(dest.stream), type(dest.type), index(dest.index), ip(dest.ip), port(dest.port) {}
+            : stream(dest.stream), type(dest.type), index(dest.index), ip(dest.ip), port(dest.port), addr(dest.addr) {}
             Destination(Destination&& dest)
             : stream(std::move(dest.stream))
             , type(std::move(dest.type))
             , index(std::move(dest.index))
             , ip(std::move(dest.ip))
-            , port(std::move(dest.port)) {}
+            , port(std::move(dest.port))
+            , addr(std::move(dest.addr)) {}
             Destination(const StreamType& stream, const TargetStreamType type, const uint8_t index)
             : stream((StreamType*)&stream), type(type), index(index), ip(), port() {}
             Destination(
@@ -145,7 +221,14 @@ namespace msgpack {
                 const uint8_t index,
                 const str_t& ip,
                 const uint16_t port)
-            : stream((StreamType*)&stream), type(type), index(index), ip(ip), port(port) {}
+            : stream((StreamType*)&stream), type(type), index(index), port(port), addr(resolve(ip)) {
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+                // frames are sent by addr, the string only identifies a host which cannot be resolved
+                if (!addr) this->ip = ip;
+#else
+                this->ip = ip;  // Packetizer::send() takes the host as is
+#endif
+            }
 
             Destination& operator=(const Destination& dest) {
                 stream = dest.stream;
@@ -153,6 +236,7 @@ namespace msgpack {
                 index = dest.index;
                 ip = dest.ip;
                 port = dest.port;
+                addr = dest.addr;
                 return *this;
             }
             Destination& operator=(Destination&& dest) {
@@ -161,32 +245,309 @@ namespace msgpack {
                 index = std::move(dest.index);
                 ip = std::move(dest.ip);
                 port = std::move(dest.port);
+                addr = std::move(dest.addr);
                 return *this;
             }
             inline bool operator<(const Destination& rhs) const {
                 return (stream != rhs.stream) ? (stream < rhs.stream)
                      : (type != rhs.type)     ? (type < rhs.type)
                      : (index != rhs.index)   ? (index < rhs.index)
-                     : (ip != rhs.ip)         ? (ip < rhs.ip)
-                                              : (port < rhs.port);
+                     : (port != rhs.port)     ? (port < rhs.port)
+                     : (addr != rhs.addr)     ? (addr < rhs.addr)
+                                              : (!addr && (ip < rhs.ip));
             }
             inline bool operator==(const Destination& rhs) const {
-                return (stream == rhs.stream) && (type == rhs.type) && (index == rhs.index) && (ip == rhs.ip)
-                    && (port == rhs.port);
+                return (stream == rhs.stream) && (type == rhs.type) && (index == rhs.index) && (port == rhs.port)
+                    && (addr == rhs.addr) && (addr || (ip == rhs.ip));
             }
             inline bool operator!=(const Destination& rhs) const {
                 return !(*this == rhs);
             }
+
+            // UDP peer to keep state per peer (e.g. latency stamp), 0 for point-to-point streams
+            uint64_t peer() const {
+                return (type == TargetStreamType::STREAM_UDP) ? latency::peer(addr, port) : 0;
+            }
+
+            // IPv4 address in host byte order, host names are looked up here once on POSIX (0: not resolved)
+            static uint32_t resolve(const str_t& ip) {
+                uint32_t a = parse(ip);
+#if defined(MSGPACKETIZER_ENABLE_POSIX) && defined(MSGPACKETIZER_ENABLE_NETWORK)
+                if (!a && !(a = UDP::lookup(ip))) LOG_ERROR(F("cannot resolve host: "), ip.c_str());
+#endif
+                return a;
+            }
+
+            // dotted IPv4 address in host byte order, 0 if it is not
+            static uint32_t parse(const str_t& ip) {
+                const char* c = ip.c_str();
+                uint32_t a = 0;
+                for (uint8_t i = 0; i < 4; ++i) {
+                    if ((*c < '0') || (*c > '9')) return 0;
+                    uint32_t octet = 0;
+                    while ((*c >= '0') && (*c <= '9')) {
+                        octet = octet * 10 + (uint32_t)(*c++ - '0');
+                        if (octet > 255) return 0;
+                    }
+                    if (*c != ((i < 3) ? '.' : '\0')) return 0;
+                    if (i < 3) ++c;
+                    a = (a << 8) | octet;
+                }
+                return a;
+            }
         };
 
+        namespace detail {
+#ifdef MSGPACKETIZER_ENABLE_PACKETIZER_STREAM
+            template <typename S>
+            inline auto send_frame(S& stream, const uint8_t index, const uint8_t* data, const size_t size)
+                -> std::enable_if_t<!is_posix_stream<S>::value> {
+                trace::Scope scope(trace::WRITE, index);
+                Packetizer::send(stream, index, data, size);
+            }
+#endif
+
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+            template <typename S>
+            inline auto send_frame(S& stream, const uint8_t index, const uint8_t* data, const size_t size)
+                -> std::enable_if_t<is_posix_stream<S>::value> {
+                stream.send(index, data, size);
+            }
+#endif
+
+            // write the frame encoded in advance
+#ifdef MSGPACKETIZER_ENABLE_PACKETIZER_STREAM
+            template <typename S>
+            inline auto write_frame(S& stream, const uint8_t index, const uint8_t* data, const size_t size)
+                -> std::enable_if_t<!is_posix_stream<S>::value> {
+                trace::Scope scope(trace::WRITE, index);
+#ifdef OF_VERSION_MAJOR
+                stream.writeBytes(data, size);
+#else
+                stream.write(data, size);
+#endif
+            }
+#endif
+
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+            template <typename S>
+            inline auto write_frame(S& stream, const uint8_t index, const uint8_t* data, const size_t size)
+                -> std::enable_if_t<is_posix_stream<S>::value> {
+                trace::Scope scope(trace::WRITE, index);
+                stream.write(data, size);
+            }
+#endif
+
+            // write bytes as many as the stream accepts without blocking
+#ifdef MSGPACKETIZER_ENABLE_PACKETIZER_STREAM
+            template <typename S>
+            inline auto write_some(S& stream, const uint8_t* data, const size_t size)
+                -> std::enable_if_t<!is_posix_stream<S>::value, size_t> {
+#ifdef ARDUINO
+                const int n = stream.availableForWrite();
+                if (n <= 0) return 0;
+                return stream.write(data, ((size_t)n < size) ? (size_t)n : size);
+#elif defined(OF_VERSION_MAJOR)
+                const long n = stream.writeBytes(data, size);
+                return (n > 0) ? (size_t)n : 0;
+#else
+                return stream.write(data, size);  // writability cannot be known
+#endif
+            }
+#endif
+
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+            template <typename S>
+            inline auto write_some(S& stream, const uint8_t* data, const size_t size)
+                -> std::enable_if_t<is_posix_stream<S>::value, size_t> {
+                return stream.writeSome(data, size);
+            }
+#endif
+
+#if defined(MSGPACKETIZER_ENABLE_NETWORK) && !defined(MSGPACKETIZER_ENABLE_POSIX)
+            inline void send_frame(
+                UDP& stream,
+                const str_t& ip,
+                const uint16_t port,
+                const uint8_t index,
+                const uint8_t* data,
+                const size_t size) {
+                trace::Scope scope(trace::WRITE, index);
+                Packetizer::send(stream, ip, port, index, data, size);
+            }
+#endif
+        }  // namespace detail
+
 #endif  // MSGPACKETIZER_ENABLE_STREAM
 
 #ifdef MSGPACKETIZER_ENABLE_STREAM
+
+        // token bucket of bytes which can be written to one stream
+        struct LinkBudget {
+            uint32_t bytes_per_sec;
+            int32_t burst;
+            int32_t tokens;  // negative while CONTROL frames exceed the budget
+            uint32_t last_us;
+
+            void refill(const uint32_t now_us) {
+                const uint64_t added = (uint64_t)(uint32_t)(now_us - last_us) * bytes_per_sec / 1000000;
+                if (added == 0) return;  // keep fraction until at least one byte is added
+                tokens = ((int64_t)tokens + (int64_t)added > burst) ? burst : (int32_t)(tokens + added);
+                last_us = now_us;
+            }
+
+            // frames larger than half of the burst go into debt instead of waiting for full bucket
+            bool acquire(const Priority priority, const size_t frame_size) {
+                const int32_t size = (int32_t)frame_size;
+                const int32_t reserve = (priority == Priority::BACKGROUND) ? burst / 4 : 0;
+                const int32_t need = ((size < burst / 2) ? size : burst / 2) + reserve;
+                if ((priority != Priority::CONTROL) && (tokens < need)) return false;
+                tokens -= size;
+                return true;
+            }
+        };
+
+        namespace detail {
+            // bytes on the wire: index, crc, COBS overhead and delimiter
+            inline size_t frame_size(const size_t payload_size) {
+                return payload_size + 4 + payload_size / 254;
+            }
+        }  // namespace detail
+
+        // published message larger than fragment size, whose fragments are sent over several post()
+        struct Transfer {
+            Destination dest;
+            Priority priority;
+            uint8_t id;
+            size_t chunk;   // max data bytes in one fragment
+            size_t offset;  // of next fragment
+            fragment::Buffer payload;
+        };
+
+        // what to do when a frame is sent to the full outbound queue
+        enum class Overflow : uint8_t {
+            DROP_OLDEST,  // drop the oldest frame which is not being written
+            DROP_NEWEST,  // drop the new frame
+            COALESCE,     // replace queued frame of the same index by the new one (drop oldest if full)
+        };
+
+        // state of outbound queue of a stream
+        struct Backpressure {
+            size_t frames {0};     // frames waiting for the stream to be writable
+            size_t bytes {0};      // bytes waiting for the stream to be writable
+            uint32_t dropped {0};  // frames dropped or coalesced by overflow policy
+            bool full {false};
+        };
+
+        struct OutboundFrame {
+            uint8_t index;
+            bool b_fragment;  // fragments are never coalesced
+            codec::Buffer bytes;
+        };
+
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+        using OutboundFrameList = std::vector<OutboundFrame>;
+#else
+        using OutboundFrameList = arx::stdx::vector<OutboundFrame, MSGPACKETIZER_MAX_OUTBOUND_QUEUE_SIZE>;
+#endif
+
+        // frames to a stream which are written as the stream becomes writable
+        struct Outbox {
+            TargetStreamType type;
+            size_t capacity;
+            Overflow policy;
+            OutboundFrameList frames;
+            size_t written {0};  // bytes of the first frame already written
+            size_t bytes {0};
+            uint32_t dropped {0};
+        };
+
+        // link capacity of a stream estimated from writes of every period
+        struct RateControl {
+            uint32_t period_begin_us {0};
+            uint32_t written {0};     // bytes written in this period
+            uint32_t blocked_us {0};  // time of blocking writes in this period
+            size_t backlog {0};       // bytes in outbound queue at the beginning of this period
+            uint32_t dropped {0};     // frames dropped from outbound queue before this period
+            float throughput {0.f};   // smoothed bytes/sec written
+            float demand {0.f};       // bytes/sec of publishers at their min interval
+            float capacity {0.f};     // bytes/sec for publishers (0: not limited)
+        };
+
+        // finished frame of constant element, written without encoding
+        struct ConstFrame {
+            size_t payload_size {0};
+            codec::Buffer bytes;
+        };
+
+        // publication referred by PublishHandle, the slot is reused after unpublish
+        struct PublishSlot {
+            Destination dest;
+            PublishElementRef elem;    // nullptr if the slot is free
+            uint16_t generation {1};  // incremented when the slot is freed, never 0
+        };
+
 #if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
-        using PackerMap = std::map<Destination, PublishElementRef>;
+        using PublishSlotMap = std::map<Destination, uint16_t>;
+        using PublishSlotList = std::vector<PublishSlot>;
+        using SlotIndexList = std::vector<uint16_t>;
+        using LinkBudgetMap = std::map<const StreamType*, LinkBudget>;
+        using FragmentSizeMap = std::map<const StreamType*, size_t>;
+        using TransferList = std::vector<Transfer>;
+        using StreamList = std::vector<const StreamType*>;
+        using OutboxMap = std::map<const StreamType*, Outbox>;
+        using RateControlMap = std::map<const StreamType*, RateControl>;
+        using ConstFrameMap = std::map<Destination, ConstFrame>;
 #else
-        using PackerMap = arx::stdx::map<Destination, PublishElementRef, MSGPACKETIZER_MAX_PUBLISH_DESTINATION_SIZE>;
+        using PublishSlotMap = arx::stdx::map<Destination, uint16_t, MSGPACKETIZER_MAX_PUBLISH_DESTINATION_SIZE>;
+        using PublishSlotList = arx::stdx::vector<PublishSlot, MSGPACKETIZER_MAX_PUBLISH_DESTINATION_SIZE>;
+        using SlotIndexList = arx::stdx::vector<uint16_t, MSGPACKETIZER_MAX_PUBLISH_DESTINATION_SIZE>;
+        using LinkBudgetMap = arx::stdx::map<const StreamType*, LinkBudget, MSGPACKETIZER_MAX_PUBLISH_DESTINATION_SIZE>;
+        using FragmentSizeMap = arx::stdx::map<const StreamType*, size_t, MSGPACKETIZER_MAX_PUBLISH_DESTINATION_SIZE>;
+        using TransferList = arx::stdx::vector<Transfer, MSGPACKETIZER_MAX_PUBLISH_DESTINATION_SIZE>;
+        using StreamList = arx::stdx::vector<const StreamType*, MSGPACKETIZER_MAX_PUBLISH_DESTINATION_SIZE>;
+        using OutboxMap = arx::stdx::map<const StreamType*, Outbox, MSGPACKETIZER_MAX_PUBLISH_DESTINATION_SIZE>;
+        using RateControlMap =
+            arx::stdx::map<const StreamType*, RateControl, MSGPACKETIZER_MAX_PUBLISH_DESTINATION_SIZE>;
+        using ConstFrameMap = arx::stdx::map<Destination, ConstFrame, MSGPACKETIZER_MAX_CONST_FRAME_SIZE>;
 #endif
+
+        // Returned by publish() instead of the element itself. It is the slot number and generation of the
+        // publication, so the element is found without building Destination, and a handle of unpublished
+        // slot is invalid even after the slot is reused. `handle->setFrameRate()` works as before.
+        class PublishHandle {
+            uint16_t slot {0};
+            uint16_t generation {0};  // 0: invalid
+
+        public:
+            PublishHandle() {}
+            PublishHandle(const uint16_t slot, const uint16_t generation) : slot(slot), generation(generation) {}
+
+            uint16_t getSlot() const {
+                return slot;
+            }
+            uint16_t getGeneration() const {
+                return generation;
+            }
+
+            // nullptr if unpublished
+            element::Base* get() const;
+            element::Base* operator->() const {
+                return get();
+            }
+            explicit operator bool() const {
+                return get() != nullptr;
+            }
+            operator PublishElementRef() const;
+
+            bool operator==(const PublishHandle& rhs) const {
+                return (slot == rhs.slot) && (generation == rhs.generation);
+            }
+            bool operator!=(const PublishHandle& rhs) const {
+                return !(*this == rhs);
+            }
+        };
+
 #endif  // MSGPACKETIZER_ENABLE_STREAM
 
         class PackerManager {
@@ -196,7 +557,32 @@ namespace msgpack {
 
             MsgPack::Packer encoder;
 #ifdef MSGPACKETIZER_ENABLE_STREAM
-            PackerMap addr_map;
+            PublishSlotMap addr_map;  // destination -> slot
+            PublishSlotList slots;
+            SlotIndexList free_slots;
+            LinkBudgetMap budgets;
+#ifdef MSGPACKETIZER_ENABLE_FRAGMENT
+            FragmentSizeMap fragment_sizes;
+            TransferList transfers;
+            codec::Buffer fragment_frame;
+            uint8_t fragment_id {0};
+#endif
+#ifdef MSGPACKETIZER_ENABLE_LATENCY
+            StreamList stamped_streams;  // streams which messages are prefixed by latency stamp
+            fragment::Buffer stamped;
+#endif
+#ifdef MSGPACKETIZER_ENABLE_OUTBOUND_QUEUE
+            OutboxMap outboxes;
+#endif
+            RateControlMap rates;  // streams which have adaptive publishers
+#ifdef MSGPACKETIZER_ENABLE_CONST_FRAME
+            ConstFrameMap const_frames;
+#endif
+            detail::Mutex mtx;  // routes forward frames from the thread which parses the source stream
+#if defined(MSGPACKETIZER_ENABLE_NETWORK) && defined(MSGPACKETIZER_ENABLE_POSIX)
+            bool b_posting {false};
+            std::vector<UDP*> udp_batches;  // sockets which have frames queued in this post()
+#endif
 #endif  // MSGPACKETIZER_ENABLE_STREAM
 
         public:
@@ -215,111 +601,648 @@ namespace msgpack {
 
 #ifdef MSGPACKETIZER_ENABLE_STREAM
 
-            void send(const Destination& dest, PublishElementRef elem) {
+            // returns false if the frame was deferred by link budget
+            // or the previous message to the destination is still being fragmented
+            bool send(const Destination& dest, PublishElementRef elem) {
+                if (elem->adaptive() && (rates.empty() || (rates.find(dest.stream) == rates.end())))
+                    rates[dest.stream].period_begin_us = MSGPACKETIZER_ELAPSED_MICROS();
+                if (const ConstFrame* f = getConstFrame(dest, *elem)) {
+                    elem->frame_bytes = (uint32_t)f->bytes.size();
+                    if (!acquire(dest, elem->priority, f->payload_size)) return false;
+                    transmit(dest, nullptr, f->payload_size, &f->bytes);
+                    return true;
+                }
+                // checked before encoding not to serialize large messages again while their fragments are sent
+                if (isTransferring(dest)) return false;
                 encoder.clear();
-                elem->encodeTo(encoder);
+                {
+                    trace::Scope scope(trace::ENCODE, dest.index);
+#ifdef MSGPACKETIZER_ENABLE_STATS
+                    const auto begin = stats::Clock::now();
+                    elem->encodeTo(encoder);
+                    const uint64_t ns = stats::elapsed_ns(begin);
+                    stats::Registry::getInstance().get(dest.stream).index(dest.index).encode_ns.add(ns);
+#else
+                    elem->encodeTo(encoder);
+#endif
+                }
+                const uint8_t* data = encoder.data();
+                size_t size = encoder.size();
+                stamp(dest.stream, dest.peer(), data, size);
+                elem->frame_bytes = (uint32_t)detail::frame_size(size);
+#ifdef MSGPACKETIZER_ENABLE_FRAGMENT
+                const size_t chunk = getFragmentChunk(dest.stream);
+                if (chunk && (size > chunk)) {
+                    transfers.push_back(Transfer());
+                    Transfer& t = transfers.back();
+                    t.dest = dest;
+                    t.priority = elem->priority;
+                    t.id = fragment_id++;
+                    t.chunk = chunk;
+                    t.offset = 0;
+                    for (size_t i = 0; i < size; ++i) t.payload.push_back(data[i]);
+                    return true;  // fragments are sent in post()
+                }
+#endif
+                if (!acquire(dest, elem->priority, size)) return false;
+                transmit(dest, data, size);
+                return true;
+            }
+
+            bool isTransferring(const Destination& dest) const {
+#ifdef MSGPACKETIZER_ENABLE_FRAGMENT
+                for (auto& t : transfers)
+                    if (t.dest == dest) return true;
+#else
+                (void)dest;
+#endif
+                return false;
+            }
+
+#ifdef MSGPACKETIZER_ENABLE_FRAGMENT
+            // send fragments of the transfer while link budget is left, returns true if completed
+            bool resume(Transfer& t) {
+                const size_t size = t.payload.size();
+                while (t.offset < size) {
+                    const size_t n = (size - t.offset < t.chunk) ? size - t.offset : t.chunk;
+                    fragment::encode(t.id, t.payload.data(), size, t.offset, n, fragment_frame);
+                    if (!acquire(t.dest, t.priority, fragment_frame.size())) return false;
+                    transmit(t.dest, fragment_frame.data(), fragment_frame.size());
+                    t.offset += n;
+                }
+                return true;
+            }
+#endif
+
+            bool acquire(const Destination& dest, const Priority priority, const size_t size) {
+#if defined(MSGPACKETIZER_ENABLE_NETWORK) && defined(MSGPACKETIZER_ENABLE_RELIABLE)
+                // frames are deferred while the window of the reliable channel is full
+                if ((dest.type == TargetStreamType::STREAM_UDP)
+                    && !reliable::Registry::getInstance().writable(
+                        dest.stream, dest.ip, dest.addr, dest.port, dest.index))
+                    return false;
+#endif
+                if (budgets.empty()) return true;
+                auto it = budgets.find(dest.stream);
+                return (it == budgets.end()) || it->second.acquire(priority, detail::frame_size(size));
+            }
+
+            // `frame` is the cached frame of the payload (only for byte streams), `data` is not used with it
+            void transmit(
+                const Destination& dest, const uint8_t* data, const size_t size, const codec::Buffer* frame = nullptr) {
+                detail::LockGuard lock(mtx);
+#ifdef MSGPACKETIZER_ENABLE_STATS
+                stats::Registry::getInstance().get(dest.stream).sent(dest.index, size);
+#endif
+#ifdef MSGPACKETIZER_ENABLE_MEMORY_STATS
+                memory::Registry::getInstance().sent(
+                    dest.stream, dest.index, frame ? frame->size() : detail::frame_size(size));
+#endif
+#ifdef MSGPACKETIZER_ENABLE_OUTBOUND_QUEUE
+                if (enqueue(dest.stream, dest.index, data, size, frame)) return;
+#endif
+                RateControl* rc = nullptr;
+                if (!rates.empty()) {
+                    auto it = rates.find(dest.stream);
+                    if (it != rates.end()) rc = &it->second;
+                }
+                const uint32_t begin_us = rc ? MSGPACKETIZER_ELAPSED_MICROS() : 0;
                 switch (dest.type) {
+#ifdef MSGPACKETIZER_ENABLE_PACKETIZER_STREAM
                     case TargetStreamType::STREAM_SERIAL:
-                        Packetizer::send(*dest.stream, dest.index, encoder.data(), encoder.size());
+                        if (frame)
+                            detail::write_frame(*dest.stream, dest.index, frame->data(), frame->size());
+                        else
+                            detail::send_frame(*dest.stream, dest.index, data, size);
+                        break;
+#endif
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+                    case TargetStreamType::STREAM_FD: {
+                        posix::Stream* s = reinterpret_cast<posix::Stream*>(dest.stream);
+                        if (frame)
+                            detail::write_frame(*s, dest.index, frame->data(), frame->size());
+                        else
+                            detail::send_frame(*s, dest.index, data, size);
                         break;
+                    }
+#endif
+#ifdef MSGPACKETIZER_ENABLE_SHM
+                    case TargetStreamType::STREAM_SHM:
+                        detail::send_frame(
+                            *reinterpret_cast<posix::SharedMemory*>(dest.stream), dest.index, data, size);
+                        break;
+#endif
 #ifdef MSGPACKETIZER_ENABLE_NETWORK
-                    case TargetStreamType::STREAM_UDP:
-                        Packetizer::send(
-                            *reinterpret_cast<UDP*>(dest.stream),
+                    case TargetStreamType::STREAM_UDP: {
+                        UDP* udp = reinterpret_cast<UDP*>(dest.stream);
+#ifdef MSGPACKETIZER_ENABLE_RELIABLE
+                        reliable::Registry::getInstance().send(
+                            udp,
                             dest.ip,
+                            dest.addr,
                             dest.port,
                             dest.index,
-                            encoder.data(),
-                            encoder.size());
+                            data,
+                            size,
+                            [&](const uint8_t* d, const size_t n) {
+                                write_udp(udp, dest.ip, dest.addr, dest.port, dest.index, d, n);
+                            });
+#else
+                        write_udp(udp, dest.ip, dest.addr, dest.port, dest.index, data, size);
+#endif
                         break;
-                    case TargetStreamType::STREAM_TCP:
-                        Packetizer::send(
-                            *reinterpret_cast<Client*>(dest.stream), dest.index, encoder.data(), encoder.size());
+                    }
+                    case TargetStreamType::STREAM_TCP: {
+                        Client* c = reinterpret_cast<Client*>(dest.stream);
+                        if (frame)
+                            detail::write_frame(*c, dest.index, frame->data(), frame->size());
+                        else
+                            detail::send_frame(*c, dest.index, data, size);
                         break;
+                    }
 #endif
                     default:
                         LOG_ERROR(F("This communication I/F is not supported"));
                         break;
                 }
+                if (rc) {
+                    rc->written += (uint32_t)detail::frame_size(size);
+                    rc->blocked_us += MSGPACKETIZER_ELAPSED_MICROS() - begin_us;
+                }
             }
 
+#ifdef MSGPACKETIZER_ENABLE_NETWORK
+            // `addr` is `ip` resolved by Destination::resolve(), frames are sent by addr on POSIX
+            void write_udp(
+                UDP* udp,
+                const str_t& ip,
+                const uint32_t addr,
+                const uint16_t port,
+                const uint8_t index,
+                const uint8_t* data,
+                const size_t size) {
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+                (void)ip;
+                if (!addr) return;  // the host could not be resolved, logged by Destination::resolve()
+                // frames published in the same post() are sent together by one sendmmsg
+                udp->queue(addr, port, index, data, size);
+                if (!b_posting)
+                    udp->flush();
+                else if (std::find(udp_batches.begin(), udp_batches.end(), udp) == udp_batches.end())
+                    udp_batches.push_back(udp);
+#else
+                (void)addr;
+                detail::send_frame(*udp, ip, port, index, data, size);
+#endif
+            }
+#endif  // MSGPACKETIZER_ENABLE_NETWORK
+
+#ifdef MSGPACKETIZER_ENABLE_MEMORY_STATS
+            // add live bytes of publishers, queues and buffers to the footprint
+            void footprint(memory::Footprint& fp) {
+                detail::LockGuard lock(mtx);
+                using namespace memory;
+                fp.packer.add(sizeof(PackerManager) + encoder.size());
+                fp.packer.add(map_bytes(addr_map) + vector_bytes(slots) + vector_bytes(free_slots));
+                fp.packer.add(map_bytes(budgets) + map_bytes(rates));
+#ifdef MSGPACKETIZER_ENABLE_FRAGMENT
+                fp.packer.add(map_bytes(fragment_sizes) + vector_bytes(fragment_frame) + vector_bytes(transfers));
+#endif
+#ifdef MSGPACKETIZER_ENABLE_LATENCY
+                fp.packer.add(vector_bytes(stamped_streams) + vector_bytes(stamped));
+#endif
+#ifdef MSGPACKETIZER_ENABLE_OUTBOUND_QUEUE
+                fp.packer.add(map_bytes(outboxes));
+#endif
+#ifdef MSGPACKETIZER_ENABLE_CONST_FRAME
+                fp.packer.add(map_bytes(const_frames));
+#endif
+#if defined(MSGPACKETIZER_ENABLE_NETWORK) && defined(MSGPACKETIZER_ENABLE_POSIX)
+                fp.packer.add(vector_bytes(udp_batches));
+#endif
+                for (auto& sl : slots) {
+                    if (!sl.elem) continue;
+                    const size_t n = sl.elem->bytes() + REF_OVERHEAD + sl.dest.ip.length();
+                    StreamFootprint& sf = fp.streams[sl.dest.stream];
+                    sf.publishers.add(n);
+                    sf.indices[sl.dest.index].publisher.add(n);
+                }
+#ifdef MSGPACKETIZER_ENABLE_OUTBOUND_QUEUE
+                for (auto& o : outboxes) {
+                    size_t n = vector_bytes(o.second.frames);
+                    for (auto& f : o.second.frames) n += vector_bytes(f.bytes);
+                    fp.streams[o.first].outbound.add(n);
+                }
+#endif
+#ifdef MSGPACKETIZER_ENABLE_FRAGMENT
+                for (auto& t : transfers) fp.streams[t.dest.stream].outbound.add(vector_bytes(t.payload));
+#endif
+#ifdef MSGPACKETIZER_ENABLE_CONST_FRAME
+                for (auto& c : const_frames) fp.streams[c.first.stream].outbound.add(vector_bytes(c.second.bytes));
+#endif
+            }
+#endif
+
             void post() {
-                for (auto& mp : addr_map) {
-                    if (mp.second->next()) {
-                        mp.second->last_publish_us = MSGPACKETIZER_ELAPSED_MICROS();
-                        send(mp.first, mp.second);
+                trace::Scope scope(trace::POST, 0);
+                detail::LockGuard lock(mtx);
+#if defined(MSGPACKETIZER_ENABLE_NETWORK) && defined(MSGPACKETIZER_ENABLE_POSIX)
+                b_posting = true;
+#endif
+#if defined(MSGPACKETIZER_ENABLE_NETWORK) && defined(MSGPACKETIZER_ENABLE_RELIABLE)
+                // retransmissions and acks of reliable channels
+                reliable::Registry::getInstance().update([this](
+                                                             const void* s,
+                                                             const str_t& ip,
+                                                             const uint32_t addr,
+                                                             const uint16_t port,
+                                                             const uint8_t index,
+                                                             const uint8_t* data,
+                                                             const size_t size) {
+                    write_udp(reinterpret_cast<UDP*>(const_cast<void*>(s)), ip, addr, port, index, data, size);
+                });
+#endif
+#ifdef MSGPACKETIZER_ENABLE_MEMORY_STATS
+                // outbound queues are sampled before they are drained
+                memory::Registry::getInstance().sample(
+                    memory::Side::PUBLISHER, [this](memory::Footprint& fp) { footprint(fp); });
+#endif
+#ifdef MSGPACKETIZER_ENABLE_OUTBOUND_QUEUE
+                for (auto& o : outboxes) drain(o.first, o.second);
+#endif
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+                // tails of frames which the descriptors did not accept at once
+                for (auto& sl : slots)
+                    if (sl.elem && (sl.dest.type == TargetStreamType::STREAM_FD))
+                        reinterpret_cast<posix::Stream*>(sl.dest.stream)->flush();
+#endif
+                const uint32_t now = MSGPACKETIZER_ELAPSED_MICROS();
+                for (auto& b : budgets) b.second.refill(now);
+                for (auto& r : rates) adapt(r.first, r.second, now);
+                // higher priority first, deferred elements stay due and are tried again in next post()
+                // fragments of large messages are sent after small frames of the same priority
+                for (uint8_t p = (uint8_t)Priority::CONTROL; p <= (uint8_t)Priority::BACKGROUND; ++p) {
+                    for (auto& sl : slots) {
+                        if (!sl.elem || (sl.elem->priority != (Priority)p) || !sl.elem->next()) continue;
+                        if (send(sl.dest, sl.elem)) sl.elem->last_publish_us = MSGPACKETIZER_ELAPSED_MICROS();
+#ifdef MSGPACKETIZER_ENABLE_STATS
+                        else
+                            stats::Registry::getInstance().get(sl.dest.stream).index(sl.dest.index).tx_deferred.add(1);
+#endif
+                    }
+#ifdef MSGPACKETIZER_ENABLE_FRAGMENT
+                    for (size_t i = 0; i < transfers.size();) {
+                        if ((transfers[i].priority == (Priority)p) && resume(transfers[i]))
+                            transfers.erase(transfers.begin() + i);
+                        else
+                            ++i;
                     }
+#endif
                 }
+#if defined(MSGPACKETIZER_ENABLE_NETWORK) && defined(MSGPACKETIZER_ENABLE_POSIX)
+                b_posting = false;
+                for (auto* udp : udp_batches) udp->flush();
+                udp_batches.clear();
+#endif
             }
 
             // for Serial and TCP (Client)
 
             template <typename S>
-            PublishElementRef publish(const S& stream, const uint8_t index, const char* const value) {
+            PublishHandle publish(const S& stream, const uint8_t index, const char* const value) {
                 return publish_impl(stream, index, make_element_ref(value));
             }
 
             template <typename S, typename T>
             auto publish(const S& stream, const uint8_t index, T& value)
-                -> std::enable_if_t<!arx::is_callable<T>::value, PublishElementRef> {
+                -> std::enable_if_t<!arx::is_callable<T>::value, PublishHandle> {
                 return publish_impl(stream, index, make_element_ref(value));
             }
 
             template <typename S, typename T>
             auto publish(const S& stream, const uint8_t index, const T& value)
-                -> std::enable_if_t<!arx::is_callable<T>::value, PublishElementRef> {
+                -> std::enable_if_t<!arx::is_callable<T>::value, PublishHandle> {
                 return publish_impl(stream, index, make_element_ref(value));
             }
 
             template <typename S, typename Func>
             auto publish(const S& stream, const uint8_t index, Func&& func)
-                -> std::enable_if_t<arx::is_callable<Func>::value, PublishElementRef> {
+                -> std::enable_if_t<arx::is_callable<Func>::value, PublishHandle> {
                 return publish(stream, index, arx::function_traits<Func>::cast(func));
             }
 
             template <typename S, typename T>
-            PublishElementRef publish(const S& stream, const uint8_t index, std::function<T()>&& getter) {
+            PublishHandle publish(const S& stream, const uint8_t index, std::function<T()>&& getter) {
                 return publish_impl(stream, index, make_element_ref(getter));
             }
 
             template <typename S, typename... Args>
-            PublishElementRef publish(const S& stream, const uint8_t index, Args&&... args) {
+            PublishHandle publish(const S& stream, const uint8_t index, Args&&... args) {
                 ElementTupleRef v {make_element_ref(std::forward<Args>(args))...};
                 return publish_impl(stream, index, make_element_ref(v));
             }
 
             template <typename S, typename... Args>
-            PublishElementRef publish_arr(const S& stream, const uint8_t index, Args&&... args) {
-                static MsgPack::arr_size_t s(sizeof...(args));
+            PublishHandle publish_arr(const S& stream, const uint8_t index, Args&&... args) {
+                static const MsgPack::arr_size_t s(sizeof...(args));
                 return publish(stream, index, s, std::forward<Args>(args)...);
             }
 
             template <typename S, typename... Args>
-            PublishElementRef publish_map(const S& stream, const uint8_t index, Args&&... args) {
+            PublishHandle publish_map(const S& stream, const uint8_t index, Args&&... args) {
                 if ((sizeof...(args) % 2) == 0) {
-                    static MsgPack::map_size_t s(sizeof...(args) / 2);
+                    static const MsgPack::map_size_t s(sizeof...(args) / 2);
                     return publish(stream, index, s, std::forward<Args>(args)...);
                 } else {
                     LOG_WARN(F("serialize arg size must be even for map :"), sizeof...(args));
-                    return nullptr;
+                    return PublishHandle();
                 }
             }
 
             template <typename S>
             void unpublish(const S& stream, const uint8_t index) {
-                Destination dest = getDestination(stream, index);
-                addr_map.erase(dest);
+                unpublish(find(getDestination(stream, index)));
+            }
+
+            void unpublish(const PublishHandle& handle) {
+                PublishSlot* sl = getSlot(handle);
+                if (!sl) return;
+                addr_map.erase(sl->dest);
+#ifdef MSGPACKETIZER_ENABLE_CONST_FRAME
+                const_frames.erase(sl->dest);
+#endif
+                cancelTransfer(sl->dest);
+                sl->elem.reset();
+                if (++sl->generation == 0) sl->generation = 1;
+                free_slots.push_back(handle.getSlot());
             }
 
             template <typename S>
             PublishElementRef getPublishElementRef(const S& stream, const uint8_t index) {
-                Destination dest = getDestination(stream, index);
-                return addr_map[dest];
+                return getPublishElementRef(find(getDestination(stream, index)));
+            }
+
+            PublishElementRef getPublishElementRef(const PublishHandle& handle) {
+                PublishSlot* sl = getSlot(handle);
+                return sl ? sl->elem : nullptr;
+            }
+
+            // nullptr if the handle is invalid or unpublished
+            PublishSlot* getSlot(const PublishHandle& handle) {
+                if (handle.getSlot() >= slots.size()) return nullptr;
+                PublishSlot& sl = slots[handle.getSlot()];
+                return (sl.elem && (sl.generation == handle.getGeneration())) ? &sl : nullptr;
             }
 
+            template <typename S>
+            PublishHandle getPublishHandle(const S& stream, const uint8_t index) {
+                return find(getDestination(stream, index));
+            }
+
+            // limit bytes published to the stream per second (0: no limit)
+            // `burst_bytes` is the size of token bucket (0: 10 msec of the rate, at least 64 bytes)
+            template <typename S>
+            void setLinkBudget(const S& stream, const uint32_t bytes_per_sec, const uint32_t burst_bytes = 0) {
+                detail::LockGuard lock(mtx);
+                const StreamType* key = (const StreamType*)&stream;
+                if (bytes_per_sec == 0) {
+                    auto it = budgets.find(key);
+                    if (it != budgets.end()) budgets.erase(it);
+                    return;
+                }
+                const uint32_t burst = burst_bytes ? burst_bytes : bytes_per_sec / 100;
+                LinkBudget b;
+                b.bytes_per_sec = bytes_per_sec;
+                b.burst = (int32_t)((burst > 64) ? burst : 64);
+                b.tokens = b.burst;
+                b.last_us = MSGPACKETIZER_ELAPSED_MICROS();
+                budgets[key] = b;
+            }
+
+            // split payloads larger than `bytes` (including fragment header) into fragments (0: disable)
+            template <typename S>
+            void setFragmentSize(const S& stream, const size_t bytes) {
+#ifdef MSGPACKETIZER_ENABLE_FRAGMENT
+                detail::LockGuard lock(mtx);
+                const StreamType* key = (const StreamType*)&stream;
+                if (bytes == 0) {
+                    auto it = fragment_sizes.find(key);
+                    if (it != fragment_sizes.end()) fragment_sizes.erase(it);
+                } else if (bytes <= fragment::HEADER_SIZE) {
+                    LOG_ERROR(F("fragment size must be larger than its header: "), bytes);
+                } else {
+                    fragment_sizes[key] = bytes;
+                }
+#else
+                (void)stream;
+                (void)bytes;
+                LOG_WARN(F("define MSGPACKETIZER_ENABLE_FRAGMENT to use fragmentation"));
+#endif
+            }
+
+            // prefix messages to the stream by latency stamp (see latency::Registry)
+            template <typename S>
+            void setLatencyStamp(const S& stream, const bool b_enable) {
+#ifdef MSGPACKETIZER_ENABLE_LATENCY
+                detail::LockGuard lock(mtx);
+                const StreamType* key = (const StreamType*)&stream;
+                for (size_t i = 0; i < stamped_streams.size(); ++i) {
+                    if (stamped_streams[i] == key) {
+                        if (!b_enable) stamped_streams.erase(stamped_streams.begin() + i);
+                        return;
+                    }
+                }
+                if (b_enable) stamped_streams.push_back(key);
+#else
+                (void)stream;
+                if (b_enable) LOG_WARN(F("define MSGPACKETIZER_ENABLE_LATENCY to use latency stamp"));
+#endif
+            }
+
+            // replace `data` and `size` by stamped message if latency stamp is enabled for the stream
+            void stamp(const StreamType* stream, const uint64_t peer, const uint8_t*& data, size_t& size) {
+#ifdef MSGPACKETIZER_ENABLE_LATENCY
+                if (!isStamped(stream)) return;
+                stamped.clear();
+                latency::Registry::getInstance().stamp(stream, peer, stamped);
+                for (size_t i = 0; i < size; ++i) stamped.push_back(data[i]);
+                data = stamped.data();
+                size = stamped.size();
+#else
+                (void)stream;
+                (void)peer;
+                (void)data;
+                (void)size;
+#endif
+            }
+
+            bool isStamped(const StreamType* stream) const {
+#ifdef MSGPACKETIZER_ENABLE_LATENCY
+                for (auto* s : stamped_streams)
+                    if (s == stream) return true;
+#else
+                (void)stream;
+#endif
+                return false;
+            }
+
+            // call `sender(data, size)` for the payload, or for every fragment if it is larger than fragment size
+            // `peer` is the UDP peer (see Destination::peer()) or 0
+            template <typename F>
+            void split(const StreamType* stream, const uint64_t peer, const uint8_t* data, size_t size, F&& sender) {
+                detail::LockGuard lock(mtx);
+                stamp(stream, peer, data, size);
+                const size_t chunk = getFragmentChunk(stream);
+                if (!chunk || (size <= chunk)) {
+                    sender(data, size);
+                    return;
+                }
+#ifdef MSGPACKETIZER_ENABLE_FRAGMENT
+                const uint8_t id = fragment_id++;
+                for (size_t offset = 0; offset < size; offset += chunk) {
+                    const size_t n = (size - offset < chunk) ? size - offset : chunk;
+                    fragment::encode(id, data, size, offset, n, fragment_frame);
+                    sender(fragment_frame.data(), fragment_frame.size());
+                }
+#endif
+            }
+
+            // bytes which can be published now (negative if CONTROL frames exceed the budget)
+            template <typename S>
+            int32_t getLinkBudget(const S& stream) {
+                detail::LockGuard lock(mtx);
+                auto it = budgets.find((const StreamType*)&stream);
+                return (it == budgets.end()) ? INT32_MAX : it->second.tokens;
+            }
+
+            // queue up to `max_frames` frames to the stream instead of blocking when it is not writable (0: disable)
+            // on Arduino, the stream must report free space by availableForWrite() (it is checked here)
+            template <typename S>
+            void setOutboundQueue(const S& stream, const size_t max_frames, const Overflow policy) {
+#ifdef MSGPACKETIZER_ENABLE_OUTBOUND_QUEUE
+                detail::LockGuard lock(mtx);
+                const StreamType* key = (const StreamType*)&stream;
+                const TargetStreamType type = getDestination(stream, 0).type;
+                if ((type != TargetStreamType::STREAM_SERIAL) && (type != TargetStreamType::STREAM_FD)
+                    && (type != TargetStreamType::STREAM_TCP)) {
+                    LOG_WARN(F("outbound queue is only available for byte streams"));
+                    return;
+                }
+                if (max_frames == 0) {
+                    auto it = outboxes.find(key);
+                    if (it != outboxes.end()) outboxes.erase(it);
+                    return;
+                }
+#ifdef ARDUINO
+                // Print::availableForWrite() returns 0 unless the stream overrides it (e.g. SoftwareSerial and
+                // many Clients), then queued frames would never be written
+                if (const_cast<S&>(stream).availableForWrite() <= 0) {
+                    LOG_WARN(F("outbound queue requires a stream whose availableForWrite() reports free space"));
+                    return;
+                }
+#endif
+                Outbox& o = outboxes[key];
+                o.type = type;
+                o.capacity = max_frames;
+                o.policy = policy;
+#else
+                (void)stream;
+                (void)policy;
+                if (max_frames) LOG_WARN(F("define MSGPACKETIZER_ENABLE_OUTBOUND_QUEUE to use outbound queue"));
+#endif
+            }
+
+#ifdef MSGPACKETIZER_ENABLE_NETWORK
+            void setOutboundQueue(const UDP&, const size_t, const Overflow) {
+                LOG_WARN(F("outbound queue is only available for byte streams"));
+            }
+#endif
+
+            template <typename S>
+            Backpressure getBackpressure(const S& stream) {
+                Backpressure b;
+#ifdef MSGPACKETIZER_ENABLE_OUTBOUND_QUEUE
+                detail::LockGuard lock(mtx);
+                auto it = outboxes.find((const StreamType*)&stream);
+                if (it == outboxes.end()) return b;
+                const Outbox& o = it->second;
+                b.frames = o.frames.size();
+                b.bytes = o.bytes;
+                b.dropped = o.dropped;
+                b.full = o.frames.size() >= o.capacity;
+#else
+                (void)stream;
+#endif
+                return b;
+            }
+
+            // bytes/sec estimated for publishers to the stream (0: not limited or no adaptive publisher)
+            template <typename S>
+            float getLinkCapacity(const S& stream) {
+                detail::LockGuard lock(mtx);
+                auto it = rates.find((const StreamType*)&stream);
+                return (it == rates.end()) ? 0.f : it->second.capacity;
+            }
+
+#ifdef MSGPACKETIZER_ENABLE_OUTBOUND_QUEUE
+            // queue the frame if the stream has outbound queue, returns false if it should be written directly
+            bool enqueue(
+                const StreamType* stream,
+                const uint8_t index,
+                const uint8_t* data,
+                const size_t size,
+                const codec::Buffer* frame = nullptr) {
+                detail::LockGuard lock(mtx);
+                if (outboxes.empty()) return false;
+                auto it = outboxes.find(stream);
+                if (it == outboxes.end()) return false;
+                Outbox& o = it->second;
+                const size_t first = o.written ? 1 : 0;  // the frame being written cannot be dropped
+                const bool b_fragment = !frame && fragment::is_fragment(data, size);
+                OutboundFrame* f = nullptr;
+                if ((o.policy == Overflow::COALESCE) && !b_fragment) {
+                    for (size_t i = first; i < o.frames.size(); ++i) {
+                        if ((o.frames[i].index == index) && !o.frames[i].b_fragment) {
+                            f = &o.frames[i];
+                            o.bytes -= f->bytes.size();
+                            ++o.dropped;
+                            break;
+                        }
+                    }
+                }
+                if (!f) {
+                    if (o.frames.size() >= o.capacity) {
+                        ++o.dropped;
+                        if ((o.policy == Overflow::DROP_NEWEST) || (first >= o.frames.size())) {
+                            drain(stream, o);
+                            return true;
+                        }
+                        o.bytes -= o.frames[first].bytes.size();
+                        o.frames.erase(o.frames.begin() + first);
+                    }
+                    o.frames.push_back(OutboundFrame());
+                    f = &o.frames.back();
+                    f->index = index;
+                    f->b_fragment = b_fragment;
+                }
+                {
+                    trace::Scope scope(trace::FRAME, index);
+                    if (frame) {
+                        f->bytes = *frame;
+                    } else {
+                        f->bytes.clear();
+                        codec::encode(index, data, size, f->bytes);
+                    }
+                }
+                o.bytes += f->bytes.size();
+                drain(stream, o);
+                return true;
+            }
+#endif  // MSGPACKETIZER_ENABLE_OUTBOUND_QUEUE
+
 #ifdef MSGPACKETIZER_ENABLE_NETWORK
 
-            PublishElementRef publish(
+            PublishHandle publish(
                 const UDP& stream,
                 const str_t& ip,
                 const uint16_t port,
@@ -330,24 +1253,24 @@ namespace msgpack {
 
             template <typename T>
             auto publish(const UDP& stream, const str_t& ip, const uint16_t port, const uint8_t index, T& value)
-                -> std::enable_if_t<!arx::is_callable<T>::value, PublishElementRef> {
+                -> std::enable_if_t<!arx::is_callable<T>::value, PublishHandle> {
                 return publish_impl(stream, ip, port, index, make_element_ref(value));
             }
 
             template <typename T>
             auto publish(const UDP& stream, const str_t& ip, const uint16_t port, const uint8_t index, const T& value)
-                -> std::enable_if_t<!arx::is_callable<T>::value, PublishElementRef> {
+                -> std::enable_if_t<!arx::is_callable<T>::value, PublishHandle> {
                 return publish_impl(stream, ip, port, index, make_element_ref(value));
             }
 
             template <typename Func>
             auto publish(const UDP& stream, const str_t& ip, const uint16_t port, const uint8_t index, Func&& func)
-                -> std::enable_if_t<arx::is_callable<Func>::value, PublishElementRef> {
+                -> std::enable_if_t<arx::is_callable<Func>::value, PublishHandle> {
                 return publish(stream, ip, port, index, arx::function_traits<Func>::cast(func));
             }
 
             template <typename T>
-            PublishElementRef publish(
+            PublishHandle publish(
                 const UDP& stream,
                 const str_t& ip,
                 const uint16_t port,
@@ -357,45 +1280,235 @@ namespace msgpack {
             }
 
             template <typename... Args>
-            PublishElementRef publish(
+            PublishHandle publish(
                 const UDP& stream, const str_t& ip, const uint16_t port, const uint8_t index, Args&&... args) {
                 ElementTupleRef v {make_element_ref(std::forward<Args>(args))...};
                 return publish_impl(stream, ip, port, index, make_element_ref(v));
             }
 
             template <typename... Args>
-            PublishElementRef publish_arr(
+            PublishHandle publish_arr(
                 const UDP& stream, const str_t& ip, const uint16_t port, const uint8_t index, Args&&... args) {
-                static MsgPack::arr_size_t s(sizeof...(args));
+                static const MsgPack::arr_size_t s(sizeof...(args));
                 return publish(stream, ip, port, index, s, std::forward<Args>(args)...);
             }
 
             template <typename... Args>
-            PublishElementRef publish_map(
+            PublishHandle publish_map(
                 const UDP& stream, const str_t& ip, const uint16_t port, const uint8_t index, Args&&... args) {
                 if ((sizeof...(args) % 2) == 0) {
-                    static MsgPack::map_size_t s(sizeof...(args) / 2);
+                    static const MsgPack::map_size_t s(sizeof...(args) / 2);
                     return publish(stream, ip, port, index, s, std::forward<Args>(args)...);
                 } else {
                     LOG_WARN(F("serialize arg size must be even for map :"), sizeof...(args));
-                    return nullptr;
+                    return PublishHandle();
                 }
             }
 
             void unpublish(const UDP& stream, const str_t& ip, const uint16_t port, const uint8_t index) {
-                Destination dest = getDestination(stream, ip, port, index);
-                addr_map.erase(dest);
+                unpublish(find(getDestination(stream, ip, port, index)));
             }
 
             PublishElementRef getPublishElementRef(
                 const UDP& stream, const str_t& ip, const uint16_t port, const uint8_t index) {
-                Destination dest = getDestination(stream, ip, port, index);
-                return addr_map[dest];
+                return getPublishElementRef(find(getDestination(stream, ip, port, index)));
+            }
+
+            PublishHandle getPublishHandle(
+                const UDP& stream, const str_t& ip, const uint16_t port, const uint8_t index) {
+                return find(getDestination(stream, ip, port, index));
             }
 
 #endif  // MSGPACKETIZER_ENABLE_NETWORK
 
         private:
+            // Estimate capacity once a period: if the link was congested (writes blocked more than half of the
+            // period, or outbound queue grew or dropped frames), capacity is set below measured throughput,
+            // otherwise it is slowly increased to probe the link. Link budget is used as the upper limit.
+            void adapt(const StreamType* stream, RateControl& rc, const uint32_t now) {
+                const uint32_t elapsed = now - rc.period_begin_us;
+                if (elapsed < MSGPACKETIZER_ADAPTIVE_PERIOD_USEC) return;
+                const float measured = (float)rc.written * 1000000.f / (float)elapsed;
+                rc.throughput = (rc.throughput > 0.f) ? rc.throughput * 0.7f + measured * 0.3f : measured;
+                bool b_congested = rc.blocked_us > elapsed / 2;
+#ifdef MSGPACKETIZER_ENABLE_OUTBOUND_QUEUE
+                if (!outboxes.empty()) {
+                    auto it = outboxes.find(stream);
+                    if (it != outboxes.end()) {
+                        const Outbox& o = it->second;
+                        b_congested |= (o.bytes && (o.bytes > rc.backlog)) || (o.dropped != rc.dropped);
+                        rc.backlog = o.bytes;
+                        rc.dropped = o.dropped;
+                    }
+                }
+#endif
+                if (b_congested) {
+                    rc.capacity = (rc.throughput > 0.f) ? rc.throughput * 0.9f : rc.capacity * 0.5f;
+                } else if (rc.capacity > 0.f) {
+                    rc.capacity *= 1.05f;
+                    if ((rc.demand > 0.f) && (rc.capacity > rc.demand * 1.25f)) rc.capacity = rc.demand * 1.25f;
+                }
+                if (!budgets.empty()) {
+                    auto it = budgets.find(stream);
+                    const float limit = (it == budgets.end()) ? 0.f : (float)it->second.bytes_per_sec;
+                    if ((limit > 0.f) && ((rc.capacity == 0.f) || (rc.capacity > limit))) rc.capacity = limit;
+                }
+                rc.period_begin_us = now;
+                rc.written = 0;
+                rc.blocked_us = 0;
+                rc.demand = schedule(stream, rc.capacity);
+            }
+
+            // share capacity left by fixed-rate publishers among adaptive ones by their weight (water-filling)
+            // returns bytes/sec of all publishers to the stream if adaptive ones are at min interval
+            float schedule(const StreamType* stream, const float capacity) {
+                float available = capacity;
+                float weights = 0.f;
+                float demand = 0.f;
+                for (auto& sl : slots) {
+                    if (!sl.elem || (sl.dest.stream != stream)) continue;
+                    element::Base& e = *sl.elem;
+                    const uint32_t interval = e.adaptive() ? e.min_interval_us : e.interval_us;
+                    if (interval) demand += (float)e.frame_bytes * 1000000.f / (float)interval;
+                    if (!e.adaptive()) {
+                        if (e.interval_us) available -= (float)e.frame_bytes * 1000000.f / (float)e.interval_us;
+                    } else if (capacity <= 0.f) {
+                        e.interval_us = e.min_interval_us;
+                    } else {
+                        e.interval_us = 0;  // not decided yet
+                        weights += e.weight;
+                    }
+                }
+                if (capacity <= 0.f) return demand;
+                // publishers which cannot be faster than min interval leave their share to others
+                bool b_pinned = true;
+                while (b_pinned && (weights > 0.f)) {
+                    b_pinned = false;
+                    for (auto& sl : slots) {
+                        if (!sl.elem || (sl.dest.stream != stream)) continue;
+                        element::Base& e = *sl.elem;
+                        if (!e.adaptive() || e.interval_us) continue;
+                        const float share = available * e.weight / weights;
+                        const float bytes = (float)(e.frame_bytes ? e.frame_bytes : 1);
+                        if ((share > 0.f) && (bytes * 1000000.f / share < (float)e.min_interval_us)) {
+                            e.interval_us = e.min_interval_us;
+                            available -= bytes * 1000000.f / (float)e.min_interval_us;
+                            weights -= e.weight;
+                            b_pinned = true;
+                        }
+                    }
+                }
+                for (auto& sl : slots) {
+                    if (!sl.elem || (sl.dest.stream != stream)) continue;
+                    element::Base& e = *sl.elem;
+                    if (!e.adaptive() || e.interval_us) continue;
+                    const float share = (weights > 0.f) ? available * e.weight / weights : 0.f;
+                    const float bytes = (float)(e.frame_bytes ? e.frame_bytes : 1);
+                    const float us = (share > 0.f) ? bytes * 1000000.f / share : (float)e.max_interval_us;
+                    e.interval_us = (us > (float)e.max_interval_us) ? e.max_interval_us : (uint32_t)us;
+                    if (e.interval_us < e.min_interval_us) e.interval_us = e.min_interval_us;
+                }
+                return demand;
+            }
+
+#ifdef MSGPACKETIZER_ENABLE_OUTBOUND_QUEUE
+            // write queued frames while the stream accepts them without blocking
+            void drain(const StreamType* stream, Outbox& o) {
+                trace::Scope scope(trace::WRITE, 0);
+                while (!o.frames.empty()) {
+                    const codec::Buffer& f = o.frames.front().bytes;
+                    const size_t n = write_some(stream, o.type, f.data() + o.written, f.size() - o.written);
+                    o.written += n;
+                    o.bytes -= n;
+                    if (n && !rates.empty()) {
+                        auto it = rates.find(stream);
+                        if (it != rates.end()) it->second.written += (uint32_t)n;
+                    }
+                    if (o.written < f.size()) break;
+                    o.frames.erase(o.frames.begin());
+                    o.written = 0;
+                }
+            }
+
+            size_t write_some(const StreamType* stream, const TargetStreamType type, const uint8_t* data, size_t size) {
+                StreamType* s = const_cast<StreamType*>(stream);
+                switch (type) {
+#ifdef MSGPACKETIZER_ENABLE_PACKETIZER_STREAM
+                    case TargetStreamType::STREAM_SERIAL:
+                        return detail::write_some(*s, data, size);
+#endif
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+                    case TargetStreamType::STREAM_FD:
+                        return detail::write_some(*reinterpret_cast<posix::Stream*>(s), data, size);
+#endif
+#ifdef MSGPACKETIZER_ENABLE_NETWORK
+                    case TargetStreamType::STREAM_TCP:
+                        return detail::write_some(*reinterpret_cast<Client*>(s), data, size);
+#endif
+                    default:
+                        return 0;
+                }
+            }
+#endif  // MSGPACKETIZER_ENABLE_OUTBOUND_QUEUE
+
+            // frame of constant element to byte stream, encoded when it is used first
+            // nullptr if the element is not constant or its frame changes by latency stamp or fragmentation
+            const ConstFrame* getConstFrame(const Destination& dest, element::Base& elem) {
+#ifdef MSGPACKETIZER_ENABLE_CONST_FRAME
+                if (!elem.isConst() || isStamped(dest.stream)) return nullptr;
+                if ((dest.type != TargetStreamType::STREAM_SERIAL) && (dest.type != TargetStreamType::STREAM_FD)
+                    && (dest.type != TargetStreamType::STREAM_TCP))
+                    return nullptr;
+                const ConstFrame* f = nullptr;
+                auto it = const_frames.find(dest);
+                if (it != const_frames.end()) {
+                    f = &it->second;
+                } else {
+                    encoder.clear();
+                    elem.encodeTo(encoder);
+#if ARX_HAVE_LIBSTDCPLUSPLUS < 201103L
+                    if ((const_frames.size() >= MSGPACKETIZER_MAX_CONST_FRAME_SIZE)
+                        || (detail::frame_size(encoder.size()) > PACKETIZER_MAX_PACKET_BINARY_SIZE))
+                        return nullptr;
+#endif
+                    ConstFrame& c = const_frames[dest];
+                    c.payload_size = encoder.size();
+                    codec::encode(dest.index, encoder.data(), encoder.size(), c.bytes);
+                    f = &c;
+                }
+                const size_t chunk = getFragmentChunk(dest.stream);
+                return (chunk && (f->payload_size > chunk)) ? nullptr : f;
+#else
+                (void)dest;
+                (void)elem;
+                return nullptr;
+#endif
+            }
+
+            size_t getFragmentChunk(const StreamType* stream) {
+#ifdef MSGPACKETIZER_ENABLE_FRAGMENT
+                if (fragment_sizes.empty()) return 0;
+                auto it = fragment_sizes.find(stream);
+                return (it == fragment_sizes.end()) ? 0 : it->second - fragment::HEADER_SIZE;
+#else
+                (void)stream;
+                return 0;
+#endif
+            }
+
+            void cancelTransfer(const Destination& dest) {
+#ifdef MSGPACKETIZER_ENABLE_FRAGMENT
+                for (size_t i = 0; i < transfers.size(); ++i) {
+                    if (transfers[i].dest == dest) {
+                        transfers.erase(transfers.begin() + i);
+                        return;
+                    }
+                }
+#else
+                (void)dest;
+#endif
+            }
+
             Destination getDestination(const StreamType& stream, const uint8_t index) {
                 Destination s;
                 s.stream = (StreamType*)&stream;
@@ -404,23 +1517,59 @@ namespace msgpack {
                 return s;
             }
 
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+            Destination getDestination(const posix::Stream& stream, const uint8_t index) {
+                Destination s;
+                s.stream = (StreamType*)&stream;
+                s.type = TargetStreamType::STREAM_FD;
+                s.index = index;
+                return s;
+            }
+#endif
+#ifdef MSGPACKETIZER_ENABLE_SHM
+            Destination getDestination(const posix::SharedMemory& stream, const uint8_t index) {
+                Destination s;
+                s.stream = (StreamType*)&stream;
+                s.type = TargetStreamType::STREAM_SHM;
+                s.index = index;
+                return s;
+            }
+#endif
+
             template <typename S>
-            PublishElementRef publish_impl(const S& stream, const uint8_t index, PublishElementRef ref) {
-                Destination dest = getDestination(stream, index);
-                addr_map.insert(std::make_pair(dest, ref));
-                return ref;
+            PublishHandle publish_impl(const S& stream, const uint8_t index, PublishElementRef ref) {
+                return publish_impl(getDestination(stream, index), ref);
+            }
+
+            // the destination which is already published keeps its element
+            PublishHandle publish_impl(const Destination& dest, PublishElementRef ref) {
+                const PublishHandle found = find(dest);
+                if (found) return found;
+                uint16_t i = (uint16_t)slots.size();
+                if (!free_slots.empty()) {
+                    i = free_slots.back();
+                    free_slots.pop_back();
+                } else {
+                    slots.push_back(PublishSlot());
+                }
+                PublishSlot& sl = slots[i];
+                sl.dest = dest;
+                sl.elem = ref;
+                addr_map.insert(std::make_pair(dest, i));
+                getConstFrame(dest, *ref);  // constant elements are encoded only once here
+                return PublishHandle(i, sl.generation);
+            }
+
+            PublishHandle find(const Destination& dest) {
+                auto it = addr_map.find(dest);
+                if (it == addr_map.end()) return PublishHandle();
+                return PublishHandle(it->second, slots[it->second].generation);
             }
 
 #ifdef MSGPACKETIZER_ENABLE_NETWORK
 
             Destination getDestination(const UDP& stream, const str_t& ip, const uint16_t port, const uint8_t index) {
-                Destination s;
-                s.stream = (StreamType*)&stream;
-                s.type = TargetStreamType::STREAM_UDP;
-                s.index = index;
-                s.ip = ip;
-                s.port = port;
-                return s;
+                return Destination(*(const StreamType*)&stream, TargetStreamType::STREAM_UDP, index, ip, port);
             }
             Destination getDestination(const Client& stream, const uint8_t index) {
                 Destination s;
@@ -430,17 +1579,28 @@ namespace msgpack {
                 return s;
             }
 
-            PublishElementRef publish_impl(
+            PublishHandle publish_impl(
                 const UDP& stream, const str_t& ip, const uint16_t port, const uint8_t index, PublishElementRef ref) {
-                Destination dest = getDestination(stream, ip, port, index);
-                addr_map.insert(std::make_pair(dest, ref));
-                return ref;
+                return publish_impl(getDestination(stream, ip, port, index), ref);
             }
 
 #endif
 #endif  // MSGPACKETIZER_ENABLE_STREAM
         };
 
+#ifdef MSGPACKETIZER_ENABLE_STREAM
+
+        inline element::Base* PublishHandle::get() const {
+            PublishSlot* sl = PackerManager::getInstance().getSlot(*this);
+            return sl ? sl->elem.get() : nullptr;
+        }
+
+        inline PublishHandle::operator PublishElementRef() const {
+            return PackerManager::getInstance().getPublishElementRef(*this);
+        }
+
+#endif  // MSGPACKETIZER_ENABLE_STREAM
+
         template <typename... Args>
         inline const Packetizer::Packet& encode(const uint8_t index, Args&&... args) {
             auto& packer = PackerManager::getInstance().getPacker();
@@ -484,12 +1644,92 @@ namespace msgpack {
 
 #ifdef MSGPACKETIZER_ENABLE_STREAM
 
+        namespace detail {
+            template <typename S>
+            inline void send_payload(S& stream, const uint8_t index, const uint8_t* data, const size_t size) {
+                PackerManager::getInstance().split(
+                    (const StreamType*)&stream, 0, data, size, [&](const uint8_t* d, const size_t n) {
+#ifdef MSGPACKETIZER_ENABLE_STATS
+                        stats::Registry::getInstance().get(&stream).sent(index, n);
+#endif
+#ifdef MSGPACKETIZER_ENABLE_MEMORY_STATS
+                        memory::Registry::getInstance().sent(&stream, index, detail::frame_size(n));
+#endif
+#ifdef MSGPACKETIZER_ENABLE_OUTBOUND_QUEUE
+                        if (PackerManager::getInstance().enqueue((const StreamType*)&stream, index, d, n)) return;
+#endif
+                        send_frame(stream, index, d, n);
+                    });
+            }
+
+#ifdef MSGPACKETIZER_ENABLE_NETWORK
+            inline void send_payload(
+                UDP& stream,
+                const str_t& ip,
+                const uint16_t port,
+                const uint8_t index,
+                const uint8_t* data,
+                const size_t size) {
+                // resolved once for all fragments
+                const uint32_t addr = Destination::resolve(ip);
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+                if (!addr) return;
+                // fragments are sent together by one sendmmsg
+                PackerManager::getInstance().split(
+                    (const StreamType*)&stream,
+                    latency::peer(addr, port),
+                    data,
+                    size,
+                    [&](const uint8_t* d, const size_t n) {
+#ifdef MSGPACKETIZER_ENABLE_STATS
+                        stats::Registry::getInstance().get(&stream).sent(index, n);
+#endif
+#ifdef MSGPACKETIZER_ENABLE_MEMORY_STATS
+                        memory::Registry::getInstance().sent(&stream, index, detail::frame_size(n));
+#endif
+#ifdef MSGPACKETIZER_ENABLE_RELIABLE
+                        reliable::Registry::getInstance().send(
+                            &stream, ip, addr, port, index, d, n, [&](const uint8_t* f, const size_t m) {
+                                stream.queue(addr, port, index, f, m);
+                            });
+#else
+                        stream.queue(addr, port, index, d, n);
+#endif
+                    });
+                stream.flush();
+#else
+                PackerManager::getInstance().split(
+                    (const StreamType*)&stream,
+                    latency::peer(addr, port),
+                    data,
+                    size,
+                    [&](const uint8_t* d, const size_t n) {
+#ifdef MSGPACKETIZER_ENABLE_STATS
+                        stats::Registry::getInstance().get(&stream).sent(index, n);
+#endif
+#ifdef MSGPACKETIZER_ENABLE_MEMORY_STATS
+                        memory::Registry::getInstance().sent(&stream, index, detail::frame_size(n));
+#endif
+#ifdef MSGPACKETIZER_ENABLE_RELIABLE
+                        reliable::Registry::getInstance().send(
+                            &stream, ip, addr, port, index, d, n, [&](const uint8_t* f, const size_t m) {
+                                send_frame(stream, ip, port, index, f, m);
+                            });
+#else
+                        send_frame(stream, ip, port, index, d, n);
+#endif
+                    });
+#endif
+            }
+#endif  // MSGPACKETIZER_ENABLE_NETWORK
+        }  // namespace detail
+
         template <typename S, typename... Args>
         inline void send(S& stream, const uint8_t index, Args&&... args) {
             auto& packer = PackerManager::getInstance().getPacker();
             packer.clear();
             packer.serialize(std::forward<Args>(args)...);
-            Packetizer::send(stream, index, packer.data(), packer.size());
+            detail::send_payload(stream, index, packer.data(), packer.size());
         }
 
         template <typename S>
@@ -497,13 +1737,13 @@ namespace msgpack {
             auto& packer = PackerManager::getInstance().getPacker();
             packer.clear();
             packer.pack(data, size);
-            Packetizer::send(stream, index, packer.data(), packer.size());
+            detail::send_payload(stream, index, packer.data(), packer.size());
         }
 
         template <typename S>
         inline void send(S& stream, const uint8_t index) {
             auto& packer = PackerManager::getInstance().getPacker();
-            Packetizer::send(stream, index, packer.data(), packer.size());
+            detail::send_payload(stream, index, packer.data(), packer.size());
         }
 
         template <typename S, typename... Args>
@@ -511,7 +1751,7 @@ namespace msgpack {
             auto& packer = PackerManager::getInstance().getPacker();
             packer.clear();
             packer.serialize(MsgPack::arr_size_t(sizeof...(args)), std::forward<Args>(args)...);
-            Packetizer::send(stream, index, packer.data(), packer.size());
+            detail::send_payload(stream, index, packer.data(), packer.size());
         }
 
         template <typename S, typename... Args>
@@ -520,7 +1760,7 @@ namespace msgpack {
                 auto& packer = PackerManager::getInstance().getPacker();
                 packer.clear();
                 packer.serialize(MsgPack::map_size_t(sizeof...(args) / 2), std::forward<Args>(args)...);
-                Packetizer::send(stream, index, packer.data(), packer.size());
+                detail::send_payload(stream, index, packer.data(), packer.size());
             } else {
                 LOG_WARN(F("serialize arg size must be even for map :"), sizeof...(args));
             }
@@ -533,7 +1773,7 @@ namespace msgpack {
             auto& packer = PackerManager::getInstance().getPacker();
             packer.clear();
             packer.serialize(std::forward<Args>(args)...);
-            Packetizer::send(stream, ip, port, index, packer.data(), packer.size());
+            detail::send_payload(stream, ip, port, index, packer.data(), packer.size());
         }
 
         inline void send(
@@ -546,12 +1786,12 @@ namespace msgpack {
             auto& packer = PackerManager::getInstance().getPacker();
             packer.clear();
             packer.pack(data, size);
-            Packetizer::send(stream, ip, port, index, packer.data(), packer.size());
+            detail::send_payload(stream, ip, port, index, packer.data(), packer.size());
         }
 
         inline void send(UDP& stream, const str_t& ip, const uint16_t port, const uint8_t index) {
             auto& packer = PackerManager::getInstance().getPacker();
-            Packetizer::send(stream, ip, port, index, packer.data(), packer.size());
+            detail::send_payload(stream, ip, port, index, packer.data(), packer.size());
         }
 
         template <typename... Args>
@@ -559,7 +1799,7 @@ namespace msgpack {
             auto& packer = PackerManager::getInstance().getPacker();
             packer.clear();
             packer.serialize(MsgPack::arr_size_t(sizeof...(args)), std::forward<Args>(args)...);
-            Packetizer::send(stream, ip, port, index, packer.data(), packer.size());
+            detail::send_payload(stream, ip, port, index, packer.data(), packer.size());
         }
 
         template <typename... Args>
@@ -568,7 +1808,7 @@ namespace msgpack {
                 auto& packer = PackerManager::getInstance().getPacker();
                 packer.clear();
                 packer.serialize(MsgPack::map_size_t(sizeof...(args) / 2), std::forward<Args>(args)...);
-                Packetizer::send(stream, ip, port, index, packer.data(), packer.size());
+                detail::send_payload(stream, ip, port, index, packer.data(), packer.size());
             } else {
                 LOG_WARN(F("serialize arg size must be even for map :"), sizeof...(args));
             }
@@ -577,17 +1817,17 @@ namespace msgpack {
 #endif  // MSGPACKETIZER_ENABLE_NETWORK
 
         template <typename S, typename... Args>
-        inline PublishElementRef publish(const S& stream, const uint8_t index, Args&&... args) {
+        inline PublishHandle publish(const S& stream, const uint8_t index, Args&&... args) {
             return PackerManager::getInstance().publish(stream, index, std::forward<Args>(args)...);
         }
 
         template <typename S, typename... Args>
-        inline PublishElementRef publish_arr(const S& stream, const uint8_t index, Args&&... args) {
+        inline PublishHandle publish_arr(const S& stream, const uint8_t index, Args&&... args) {
             return PackerManager::getInstance().publish_arr(stream, index, std::forward<Args>(args)...);
         }
 
         template <typename S, typename... Args>
-        inline PublishElementRef publish_map(const S& stream, const uint8_t index, Args&&... args) {
+        inline PublishHandle publish_map(const S& stream, const uint8_t index, Args&&... args) {
             return PackerManager::getInstance().publish_map(stream, index, std::forward<Args>(args)...);
         }
 
@@ -596,27 +1836,36 @@ namespace msgpack {
             PackerManager::getInstance().unpublish(stream, index);
         }
 
+        inline void unpublish(const PublishHandle& handle) {
+            PackerManager::getInstance().unpublish(handle);
+        }
+
         template <typename S>
         inline PublishElementRef getPublishElementRef(const S& stream, const uint8_t index) {
             return PackerManager::getInstance().getPublishElementRef(stream, index);
         }
 
+        template <typename S>
+        inline PublishHandle getPublishHandle(const S& stream, const uint8_t index) {
+            return PackerManager::getInstance().getPublishHandle(stream, index);
+        }
+
 #ifdef MSGPACKETIZER_ENABLE_NETWORK
 
         template <typename... Args>
-        inline PublishElementRef publish(
+        inline PublishHandle publish(
             const UDP& stream, const str_t& ip, const uint16_t port, const uint8_t index, Args&&... args) {
             return PackerManager::getInstance().publish(stream, ip, port, index, std::forward<Args>(args)...);
         }
 
         template <typename... Args>
-        inline PublishElementRef publish_arr(
+        inline PublishHandle publish_arr(
             const UDP& stream, const str_t& ip, const uint16_t port, const uint8_t index, Args&&... args) {
             return PackerManager::getInstance().publish_arr(stream, ip, port, index, std::forward<Args>(args)...);
         }
 
         template <typename... Args>
-        inline PublishElementRef publish_map(
+        inline PublishHandle publish_map(
             const UDP& stream, const str_t& ip, const uint16_t port, const uint8_t index, Args&&... args) {
             return PackerManager::getInstance().publish_map(stream, ip, port, index, std::forward<Args>(args)...);
         }
@@ -625,8 +1874,14 @@ namespace msgpack {
             PackerManager::getInstance().unpublish(stream, ip, port, index);
         };
 
-        inline PublishElementRef getPublishElementRef(const UDP& stream, const uint8_t index) {
-            return PackerManager::getInstance().getPublishElementRef(stream, index);
+        inline PublishElementRef getPublishElementRef(
+            const UDP& stream, const str_t& ip, const uint16_t port, const uint8_t index) {
+            return PackerManager::getInstance().getPublishElementRef(stream, ip, port, index);
+        }
+
+        inline PublishHandle getPublishHandle(
+            const UDP& stream, const str_t& ip, const uint16_t port, const uint8_t index) {
+            return PackerManager::getInstance().getPublishHandle(stream, ip, port, index);
         }
 
 #endif  // MSGPACKETIZER_ENABLE_NETWORK
@@ -635,6 +1890,52 @@ namespace msgpack {
             PackerManager::getInstance().post();
         }
 
+        template <typename S>
+        inline void setLinkBudget(const S& stream, const uint32_t bytes_per_sec, const uint32_t burst_bytes = 0) {
+            PackerManager::getInstance().setLinkBudget(stream, bytes_per_sec, burst_bytes);
+        }
+
+        // budget of serial link: 10 bits (start, 8 data, stop) per byte
+        template <typename S>
+        inline void setLinkBaudrate(const S& stream, const uint32_t baudrate, const uint32_t burst_bytes = 0) {
+            PackerManager::getInstance().setLinkBudget(stream, baudrate / 10, burst_bytes);
+        }
+
+        template <typename S>
+        inline int32_t getLinkBudget(const S& stream) {
+            return PackerManager::getInstance().getLinkBudget(stream);
+        }
+
+        template <typename S>
+        inline void setFragmentSize(const S& stream, const size_t bytes) {
+            PackerManager::getInstance().setFragmentSize(stream, bytes);
+        }
+
+        // queue frames to the stream instead of blocking when it is not writable (max_frames 0: disable)
+        // on Arduino, streams whose availableForWrite() is not implemented (returns 0) are refused with a warning
+        template <typename S>
+        inline void setOutboundQueue(
+            const S& stream, const size_t max_frames, const Overflow policy = Overflow::DROP_OLDEST) {
+            PackerManager::getInstance().setOutboundQueue(stream, max_frames, policy);
+        }
+
+        template <typename S>
+        inline Backpressure getBackpressure(const S& stream) {
+            return PackerManager::getInstance().getBackpressure(stream);
+        }
+
+        // bytes/sec estimated for adaptive publishers to the stream (0: not limited)
+        template <typename S>
+        inline float getLinkCapacity(const S& stream) {
+            return PackerManager::getInstance().getLinkCapacity(stream);
+        }
+
+        // stamp send time to messages to the stream to measure latency on the receiver (see getLatency())
+        template <typename S>
+        inline void setLatencyStamp(const S& stream, const bool b_enable = true) {
+            PackerManager::getInstance().setLatencyStamp(stream, b_enable);
+        }
+
 #endif  // MSGPACKETIZER_ENABLE_STREAM
 
         inline const MsgPack::Packer& getPacker() {
@@ -0,0 +1,522 @@
+#pragma once
+
+#ifndef HT_SERIAL_MSGPACKETIZER_RELIABLE_H
+#define HT_SERIAL_MSGPACKETIZER_RELIABLE_H
+
+#if defined(MSGPACKETIZER_ENABLE_STREAM) && defined(MSGPACKETIZER_ENABLE_NETWORK)
+
+// number of unacknowledged frames per channel (power of two, max 32)
+#ifndef MSGPACKETIZER_RELIABLE_WINDOW
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+#define MSGPACKETIZER_RELIABLE_WINDOW 32
+#else
+#define MSGPACKETIZER_RELIABLE_WINDOW 4
+#endif
+#endif
+// retransmission timeout before the round-trip time is measured
+#ifndef MSGPACKETIZER_RELIABLE_RTO_US
+#define MSGPACKETIZER_RELIABLE_RTO_US 100000
+#endif
+#ifndef MSGPACKETIZER_RELIABLE_MIN_RTO_US
+#define MSGPACKETIZER_RELIABLE_MIN_RTO_US 2000
+#endif
+
+namespace arduino {
+namespace msgpack {
+    namespace msgpacketizer {
+
+        // Messages of the reliable index are prefixed by [0xC1][0x03][session][seq (u16)] (big endian),
+        // and the peer returns [0xC1][0x04][session][next (u16)][mask (u32)] with the same index:
+        // `next` is the first sequence not received yet and bit i of `mask` is set if `next + 1 + i` is received.
+        // Frames are kept in the send window until acknowledged, and retransmitted when a later sequence is
+        // acknowledged without them or when the retransmission timeout (estimated like TCP) expires.
+        // The receiver delivers messages in order and buffers frames received out of order within the window.
+        // The session is changed when the channel is opened, so the peer restarts its sequence with it.
+        namespace reliable {
+
+            static constexpr uint8_t KIND_DATA {0x03};
+            static constexpr uint8_t KIND_ACK {0x04};
+            static constexpr size_t DATA_HEADER_SIZE {5};
+            static constexpr size_t ACK_SIZE {9};
+            static constexpr uint16_t WINDOW {MSGPACKETIZER_RELIABLE_WINDOW};
+            static constexpr uint32_t MAX_RTO_US {1000000};
+            static_assert((WINDOW & (WINDOW - 1)) == 0, "MSGPACKETIZER_RELIABLE_WINDOW must be power of two");
+            static_assert((WINDOW >= 2) && (WINDOW <= 32), "MSGPACKETIZER_RELIABLE_WINDOW must be 2 - 32");
+
+            inline bool is_data(const uint8_t* data, const size_t size) {
+                return (size >= DATA_HEADER_SIZE) && (data[0] == fragment::MARKER) && (data[1] == KIND_DATA);
+            }
+
+            inline bool is_ack(const uint8_t* data, const size_t size) {
+                return (size == ACK_SIZE) && (data[0] == fragment::MARKER) && (data[1] == KIND_ACK);
+            }
+
+            inline uint16_t read_u16(const uint8_t* p) {
+                return (uint16_t)(((uint16_t)p[0] << 8) | (uint16_t)p[1]);
+            }
+
+            template <typename B>
+            inline void write_u16(B& out, const uint16_t v) {
+                out.push_back((uint8_t)(v >> 8));
+                out.push_back((uint8_t)v);
+            }
+
+            struct ChannelStats {
+                uint32_t sent {0};           // new frames sent
+                uint32_t retransmitted {0};  // frames sent again
+                uint32_t acked {0};          // frames acknowledged by the peer
+                uint32_t overflows {0};      // frames not sent because the window was full
+                uint32_t delivered {0};      // messages delivered to subscribers in order
+                uint32_t duplicates {0};     // frames received again
+                uint32_t reordered {0};      // frames buffered because of earlier missing frames
+                uint32_t acks_sent {0};
+                uint32_t foreign {0};        // frames from other senders than the peer, bypassing the channel
+                uint32_t rtt_us {0};  // smoothed round-trip time
+                uint32_t rto_us {0};  // current retransmission timeout
+                size_t in_flight {0};  // frames waiting for acknowledgement
+            };
+
+            // both directions of one index with one peer
+            class Channel {
+                struct TxEntry {
+                    bool b_acked {true};
+                    bool b_lost {false};  // a later frame was acknowledged without this
+                    uint8_t retries {0};
+                    uint32_t sent_us {0};
+                    codec::Buffer bytes;  // header + payload
+                };
+
+                struct RxEntry {
+                    bool b_valid {false};
+                    codec::Buffer bytes;  // payload
+                };
+
+                uint8_t session {0};
+                uint16_t base {0};      // oldest unacknowledged sequence
+                uint16_t next_seq {0};  // sequence of the next new frame
+                TxEntry tx[WINDOW];
+                uint32_t srtt_us {0};
+                uint32_t rttvar_us {0};
+                uint32_t rto_us {MSGPACKETIZER_RELIABLE_RTO_US};
+                bool b_full {false};
+                bool b_stalled {false};
+                uint32_t full_since_us {0};
+
+                bool b_peer {false};
+                uint8_t peer_session {0};
+                uint16_t expected {0};  // next sequence to be delivered
+                RxEntry rx[WINDOW];
+                bool b_ack_pending {false};
+
+                uint32_t loss_threshold {0};  // simulated loss: frames are not written if random < threshold
+                uint32_t loss_state {0x9E3779B9};
+
+            public:
+                str_t ip;
+                uint32_t addr {0};  // IPv4 in host byte order resolved by the caller (0: compared by ip)
+                uint16_t port {0};
+                ChannelStats counters;
+
+                void open(
+                    const str_t& peer_ip,
+                    const uint32_t peer_addr,
+                    const uint16_t peer_port,
+                    const uint8_t new_session) {
+                    ip = peer_ip;
+                    addr = peer_addr;
+                    port = peer_port;
+                    session = new_session;
+                }
+
+                // `sender` is latency::peer() of the datagram, unknown if the peer was not resolved
+                bool from(const uint64_t sender) const {
+                    return !addr || (latency::peer(addr, port) == sender);
+                }
+
+                bool writable() const {
+                    return (uint16_t)(next_seq - base) < WINDOW;
+                }
+
+                // store the frame in the window, returns nullptr if the window is full
+                const codec::Buffer* push(const uint8_t* data, const size_t size, const uint32_t now) {
+                    if (!writable()) {
+                        ++counters.overflows;
+                        return nullptr;
+                    }
+                    TxEntry& e = tx[next_seq % WINDOW];
+                    e.bytes.clear();
+                    e.bytes.push_back(fragment::MARKER);
+                    e.bytes.push_back(KIND_DATA);
+                    e.bytes.push_back(session);
+                    write_u16(e.bytes, next_seq);
+                    for (size_t i = 0; i < size; ++i) e.bytes.push_back(data[i]);
+                    e.b_acked = e.b_lost = false;
+                    e.retries = 0;
+                    e.sent_us = now;
+                    ++next_seq;
+                    ++counters.sent;
+                    return &e.bytes;
+                }
+
+                void ack(const uint8_t* data, const uint32_t now) {
+                    if (data[2] != session) return;  // for the previous session
+                    const uint16_t next = read_u16(data + 3);
+                    const uint32_t mask = fragment::read_u32(data + 5);
+                    const uint16_t n_flight = (uint16_t)(next_seq - base);
+                    if ((uint16_t)(next - base) > n_flight) return;  // not sent yet
+                    for (uint16_t s = base; s != next; ++s) acknowledge(tx[s % WINDOW], now);
+                    uint16_t highest = next;
+                    for (uint8_t i = 0; i < 32; ++i) {
+                        if (!(mask & ((uint32_t)1 << i))) continue;
+                        const uint16_t s = (uint16_t)(next + 1 + i);
+                        if ((uint16_t)(s - base) >= n_flight) break;
+                        acknowledge(tx[s % WINDOW], now);
+                        highest = s;
+                    }
+                    // frames before the highest selective ack are missing on the peer
+                    for (uint16_t s = next; s != highest; ++s) {
+                        TxEntry& e = tx[s % WINDOW];
+                        if (!e.b_acked && ((now - e.sent_us) >= (srtt_us ? srtt_us : rto_us))) e.b_lost = true;
+                    }
+                    while ((base != next_seq) && tx[base % WINDOW].b_acked) ++base;
+                }
+
+                // returns true if the payload is the next message to deliver,
+                // frames received out of order are buffered and delivered by pop()
+                bool receive(const uint8_t* data, const size_t size) {
+                    const uint8_t s_peer = data[2];
+                    const uint16_t seq = read_u16(data + 3);
+                    if (!b_peer || (s_peer != peer_session)) {
+                        b_peer = true;
+                        peer_session = s_peer;
+                        expected = 0;
+                        for (auto& e : rx) e.b_valid = false;
+                    }
+                    b_ack_pending = true;
+                    const uint16_t d = (uint16_t)(seq - expected);
+                    if (d == 0) {
+                        ++expected;
+                        ++counters.delivered;
+                        return true;
+                    }
+                    if (d >= WINDOW) {
+                        ++counters.duplicates;  // already delivered (or too far ahead to be buffered)
+                        return false;
+                    }
+                    RxEntry& e = rx[seq % WINDOW];
+                    if (e.b_valid) {
+                        ++counters.duplicates;
+                        return false;
+                    }
+                    e.b_valid = true;
+                    e.bytes.clear();
+                    for (size_t i = DATA_HEADER_SIZE; i < size; ++i) e.bytes.push_back(data[i]);
+                    ++counters.reordered;
+                    return false;
+                }
+
+                // move the buffered payload which is now in order to `out`
+                bool pop(codec::Buffer& out) {
+                    RxEntry& e = rx[expected % WINDOW];
+                    if (!e.b_valid) return false;
+                    e.b_valid = false;
+                    std::swap(out, e.bytes);
+                    ++expected;
+                    ++counters.delivered;
+                    return true;
+                }
+
+                // retransmit lost or timed out frames and acknowledge received frames
+                // `write(data, size)` is called for every frame
+                template <typename F>
+                void update(const uint32_t now, F&& write) {
+                    bool b_timeout = false;
+                    for (uint16_t s = base; s != next_seq; ++s) {
+                        TxEntry& e = tx[s % WINDOW];
+                        if (e.b_acked) continue;
+                        const bool b_expired = (now - e.sent_us) >= rto_us;
+                        if (!e.b_lost && !b_expired) continue;
+                        b_timeout |= !e.b_lost;
+                        e.b_lost = false;
+                        e.sent_us = now;
+                        if (e.retries < UINT8_MAX) ++e.retries;
+                        ++counters.retransmitted;
+                        transmit(e.bytes.data(), e.bytes.size(), write);
+                    }
+                    if (b_timeout) rto_us = ((rto_us * 2) < MAX_RTO_US) ? (rto_us * 2) : MAX_RTO_US;
+                    if (b_ack_pending) {
+                        uint32_t mask = 0;
+                        for (uint16_t i = 0; i + 1 < WINDOW; ++i)
+                            if (rx[(uint16_t)(expected + 1 + i) % WINDOW].b_valid) mask |= (uint32_t)1 << i;
+                        uint8_t bytes[ACK_SIZE] {fragment::MARKER, KIND_ACK, peer_session, (uint8_t)(expected >> 8),
+                                                 (uint8_t)expected, (uint8_t)(mask >> 24), (uint8_t)(mask >> 16),
+                                                 (uint8_t)(mask >> 8), (uint8_t)mask};
+                        b_ack_pending = false;
+                        ++counters.acks_sent;
+                        transmit(bytes, ACK_SIZE, write);
+                    }
+                }
+
+                // true once when the window has been full longer than MAX_RTO_US
+                // (acks are only returned by the peer which also calls setReliable() for the index)
+                bool stalled(const uint32_t now) {
+                    if (writable()) {
+                        b_full = b_stalled = false;
+                        return false;
+                    }
+                    if (!b_full) {
+                        b_full = true;
+                        full_since_us = now;
+                        return false;
+                    }
+                    if (b_stalled || ((now - full_since_us) < MAX_RTO_US)) return false;
+                    b_stalled = true;
+                    return true;
+                }
+
+                // write the frame unless it is dropped by simulated loss
+                template <typename F>
+                void transmit(const uint8_t* data, const size_t size, F&& write) {
+                    if (loss_threshold) {
+                        loss_state ^= loss_state << 13;
+                        loss_state ^= loss_state >> 17;
+                        loss_state ^= loss_state << 5;
+                        if (loss_state < loss_threshold) return;
+                    }
+                    write(data, size);
+                }
+
+                void setLoss(const float ratio) {
+                    loss_threshold = (ratio <= 0.f) ? 0
+                                   : (ratio >= 1.f) ? UINT32_MAX
+                                                    : (uint32_t)(ratio * 4294967295.f);
+                }
+
+                ChannelStats stats() const {
+                    ChannelStats s = counters;
+                    s.rtt_us = srtt_us;
+                    s.rto_us = rto_us;
+                    s.in_flight = (uint16_t)(next_seq - base);
+                    return s;
+                }
+
+            private:
+                void acknowledge(TxEntry& e, const uint32_t now) {
+                    if (e.b_acked) return;
+                    e.b_acked = true;
+                    e.b_lost = false;
+                    ++counters.acked;
+                    if (e.retries) return;  // ambiguous sample (Karn's algorithm)
+                    const uint32_t r = now - e.sent_us;
+                    if (!srtt_us) {
+                        srtt_us = r ? r : 1;
+                        rttvar_us = r / 2;
+                    } else {
+                        const uint32_t diff = (srtt_us > r) ? (srtt_us - r) : (r - srtt_us);
+                        rttvar_us = (rttvar_us * 3 + diff) / 4;
+                        srtt_us = (srtt_us * 7 + r) / 8;
+                    }
+                    const uint32_t rto = srtt_us + 4 * rttvar_us;
+                    rto_us = (rto < MSGPACKETIZER_RELIABLE_MIN_RTO_US) ? MSGPACKETIZER_RELIABLE_MIN_RTO_US
+                           : (rto > MAX_RTO_US)                     ? MAX_RTO_US
+                                                                    : rto;
+                }
+            };
+
+            struct Key {
+                const void* stream;
+                uint8_t index;
+
+                bool operator<(const Key& rhs) const {
+                    return (stream != rhs.stream) ? (stream < rhs.stream) : (index < rhs.index);
+                }
+            };
+
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+            using ChannelMap = std::map<Key, Channel>;
+#else
+            using ChannelMap = arx::stdx::map<Key, Channel, MSGPACKETIZER_MAX_RELIABLE_CHANNEL_SIZE>;
+#endif
+
+            class Registry {
+                Registry() {}
+                Registry(const Registry&) = delete;
+                Registry& operator=(const Registry&) = delete;
+
+                ChannelMap channels;
+                uint8_t sessions {0};
+                detail::Mutex mtx;
+
+            public:
+                static Registry& getInstance() {
+                    static Registry r;
+                    return r;
+                }
+
+                void open(
+                    const void* stream,
+                    const uint8_t index,
+                    const str_t& ip,
+                    const uint32_t addr,
+                    const uint16_t port) {
+                    detail::LockGuard lock(mtx);
+                    uint8_t session = (uint8_t)(MSGPACKETIZER_ELAPSED_MICROS() ^ ++sessions);
+                    channels.erase(Key {stream, index});
+                    channels[Key {stream, index}].open(ip, addr, port, session);
+                }
+
+                void close(const void* stream, const uint8_t index) {
+                    detail::LockGuard lock(mtx);
+                    channels.erase(Key {stream, index});
+                }
+
+                // false if the window of the reliable channel to the destination is full
+                bool writable(
+                    const void* stream,
+                    const str_t& ip,
+                    const uint32_t addr,
+                    const uint16_t port,
+                    const uint8_t index) {
+                    detail::LockGuard lock(mtx);
+                    const Channel* ch = find(stream, ip, addr, port, index);
+                    return !ch || ch->writable();
+                }
+
+                // `write(data, size)` is called with the payload as is if the destination is not reliable,
+                // returns false if the frame was dropped because the window is full
+                template <typename F>
+                bool send(
+                    const void* stream,
+                    const str_t& ip,
+                    const uint32_t addr,
+                    const uint16_t port,
+                    const uint8_t index,
+                    const uint8_t* data,
+                    const size_t size,
+                    F&& write) {
+                    detail::LockGuard lock(mtx);
+                    Channel* ch = find(stream, ip, addr, port, index);
+                    if (!ch) {
+                        write(data, size);
+                        return true;
+                    }
+                    const codec::Buffer* frame = ch->push(data, size, MSGPACKETIZER_ELAPSED_MICROS());
+                    if (!frame) {
+                        LOG_WARN(F("reliable window is full, dropped frame of index: "), index);
+                        return false;
+                    }
+                    ch->transmit(frame->data(), frame->size(), write);
+                    return true;
+                }
+
+                // `deliver(data, size)` is called for messages in order, acks are consumed here
+                // data frames of the index which is not reliable on this side are delivered without ordering
+                // `sender` is latency::peer() of the datagram: one channel has one peer per (socket, index),
+                // and frames from other senders are delivered without ordering and never touch its state
+                template <typename F>
+                void receive(
+                    const void* stream,
+                    const uint8_t index,
+                    const uint64_t sender,
+                    const uint8_t* data,
+                    const size_t size,
+                    F&& deliver) {
+                    bool b_ordered = false;
+                    {
+                        detail::LockGuard lock(mtx);
+                        auto it = channels.find(Key {stream, index});
+                        Channel* ch = (it == channels.end()) ? nullptr : &it->second;
+                        if (ch && !ch->from(sender)) {
+                            ++ch->counters.foreign;
+                            ch = nullptr;
+                        }
+                        if (is_ack(data, size)) {
+                            if (ch) ch->ack(data, MSGPACKETIZER_ELAPSED_MICROS());
+                            return;
+                        }
+                        if (ch && !ch->receive(data, size)) return;
+                        b_ordered = (ch != nullptr);
+                    }
+                    deliver(data + DATA_HEADER_SIZE, size - DATA_HEADER_SIZE);
+                    if (!b_ordered) return;
+                    codec::Buffer reordered;
+                    while (pop(stream, index, reordered)) deliver(reordered.data(), reordered.size());
+                }
+
+                // `write(stream, ip, addr, port, index, data, size)` is called for retransmissions and acks
+                template <typename F>
+                void update(F&& write) {
+                    detail::LockGuard lock(mtx);
+                    if (channels.empty()) return;
+                    const uint32_t now = MSGPACKETIZER_ELAPSED_MICROS();
+                    for (auto& c : channels) {
+                        const Key& k = c.first;
+                        Channel& ch = c.second;
+                        ch.update(now, [&](const uint8_t* data, const size_t size) {
+                            write(k.stream, ch.ip, ch.addr, ch.port, k.index, data, size);
+                        });
+                        if (ch.stalled(now)) {
+                            LOG_WARN(F("reliable window stays full (setReliable() on the peer?), index: "), k.index);
+                        }
+                    }
+                }
+
+                void setLoss(const void* stream, const uint8_t index, const float ratio) {
+                    detail::LockGuard lock(mtx);
+                    auto it = channels.find(Key {stream, index});
+                    if (it != channels.end()) it->second.setLoss(ratio);
+                }
+
+                ChannelStats stats(const void* stream, const uint8_t index) {
+                    detail::LockGuard lock(mtx);
+                    auto it = channels.find(Key {stream, index});
+                    return (it == channels.end()) ? ChannelStats() : it->second.stats();
+                }
+
+            private:
+                Channel* find(
+                    const void* stream,
+                    const str_t& ip,
+                    const uint32_t addr,
+                    const uint16_t port,
+                    const uint8_t index) {
+                    if (channels.empty()) return nullptr;
+                    auto it = channels.find(Key {stream, index});
+                    if (it == channels.end()) return nullptr;
+                    Channel& ch = it->second;
+                    if ((ch.port != port) || (ch.addr != addr)) return nullptr;
+                    return (addr || (ch.ip == ip)) ? &ch : nullptr;
+                }
+
+                bool pop(const void* stream, const uint8_t index, codec::Buffer& out) {
+                    detail::LockGuard lock(mtx);
+                    auto it = channels.find(Key {stream, index});
+                    return (it != channels.end()) && it->second.pop(out);
+                }
+            };
+
+        }  // namespace reliable
+
+#ifdef MSGPACKETIZER_ENABLE_RELIABLE
+
+        // delivery statistics of the reliable channel of the index
+        template <typename S>
+        inline reliable::ChannelStats getReliableStats(const S& stream, const uint8_t index) {
+            return reliable::Registry::getInstance().stats(&stream, index);
+        }
+
+        // drop frames (data and acks) of the reliable channel at the ratio (0.0 - 1.0) to test retransmission
+        template <typename S>
+        inline void setReliableLoss(const S& stream, const uint8_t index, const float ratio) {
+            reliable::Registry::getInstance().setLoss(&stream, index, ratio);
+        }
+
+#endif  // MSGPACKETIZER_ENABLE_RELIABLE
+
+    }  // namespace msgpacketizer
+}  // namespace msgpack
+}  // namespace arduino
+
+#endif  // MSGPACKETIZER_ENABLE_STREAM && MSGPACKETIZER_ENABLE_NETWORK
+
+#endif  // HT_SERIAL_MSGPACKETIZER_RELIABLE_H
@@ -0,0 +1,191 @@
+#pragma once
+
+#ifndef HT_SERIAL_MSGPACKETIZER_ROUTER_H
+#define HT_SERIAL_MSGPACKETIZER_ROUTER_H
+
+#ifdef MSGPACKETIZER_ENABLE_STREAM
+
+namespace arduino {
+namespace msgpack {
+    namespace msgpacketizer {
+
+        // Frames received from a stream are forwarded to other streams without unpacking msgpack payload.
+        // Routes see frames as received (fragments and latency stamps are forwarded as they are).
+        // The frame is encoded once for all byte streams of the same output index,
+        // and it is identical to the received frame if the index is not rewritten.
+        // Frames are forwarded on the thread which parses the source stream (the worker thread of `make_worker()`
+        // in both delivery modes). PackerManager serializes them with `post()` and other senders by its mutex,
+        // but the source and destination streams themselves must not be written by user code on another thread.
+        namespace router {
+
+            struct Route {
+                uint8_t index;     // received index
+                Destination dest;  // dest.index is the index to send
+            };
+
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+            using RouteList = std::vector<Route>;
+            using RouteMap = std::map<const StreamType*, RouteList>;
+#else
+            using RouteList = arx::stdx::vector<Route, MSGPACKETIZER_MAX_ROUTE_SIZE>;
+            using RouteMap = arx::stdx::map<const StreamType*, RouteList, PACKETIZER_MAX_STREAM_MAP_SIZE>;
+#endif
+
+            class Router {
+                Router() {}
+                Router(const Router&) = delete;
+                Router& operator=(const Router&) = delete;
+
+                RouteMap routes;
+                codec::Buffer frame;
+                detail::Mutex mtx;
+
+            public:
+                static Router& getInstance() {
+                    static Router r;
+                    return r;
+                }
+
+                template <typename S>
+                void add(S& src, const uint8_t index, const Destination& dest) {
+                    ReceiverRef receiver = detail::getReceiverRef(src);
+                    const StreamType* key = receiver->getTarget().stream;
+                    if ((key == dest.stream) && (index == dest.index)) {
+                        LOG_WARN(F("route to the same stream and index is ignored: "), index);
+                        return;
+                    }
+                    bool b_first = false;
+                    {
+                        detail::LockGuard lock(mtx);
+                        RouteList& list = routes[key];
+                        for (auto& r : list)
+                            if ((r.index == index) && (r.dest == dest)) return;
+                        b_first = list.empty();
+                        list.push_back(Route {index, dest});
+                    }
+                    // tap is called with the lock of receiver, so it is not added with the lock of router
+                    if (b_first) {
+                        receiver->tap(this, [this, key](const uint8_t i, const uint8_t* data, const size_t size) {
+                            forward(key, i, data, size);
+                        });
+                    }
+                }
+
+                // remove routes of the index (or all routes if `b_all`) from the stream
+                void remove(const DecodeTargetStream& src, const uint8_t index, const bool b_all) {
+                    bool b_empty = false;
+                    {
+                        detail::LockGuard lock(mtx);
+                        auto it = routes.find(src.stream);
+                        if (it == routes.end()) return;
+                        RouteList& list = it->second;
+                        for (size_t i = 0; i < list.size();) {
+                            if (b_all || (list[i].index == index))
+                                list.erase(list.begin() + i);
+                            else
+                                ++i;
+                        }
+                        b_empty = list.empty();
+                        if (b_empty) routes.erase(it);
+                    }
+                    auto& manager = UnpackerManager::getInstance();
+                    if (b_empty && manager.hasReceiver(src)) manager.getReceiverRef(src)->untap(this);
+                }
+
+                void forward(const StreamType* src, const uint8_t index, const uint8_t* data, const size_t size) {
+                    detail::LockGuard lock(mtx);
+                    auto it = routes.find(src);
+                    if (it == routes.end()) return;
+                    bool b_framed = false;
+                    uint8_t framed_index = 0;
+                    for (auto& r : it->second) {
+                        if (r.index != index) continue;
+                        const codec::Buffer* f = nullptr;
+                        if (isByteStream(r.dest.type) && canFrame(size)) {
+                            if (!b_framed || (framed_index != r.dest.index)) {
+                                trace::Scope scope(trace::FRAME, r.dest.index);
+                                frame.clear();
+                                codec::encode(r.dest.index, data, size, frame);
+                                b_framed = true;
+                                framed_index = r.dest.index;
+                            }
+                            f = &frame;
+                        }
+                        PackerManager::getInstance().transmit(r.dest, data, size, f);
+                    }
+                }
+
+            private:
+                static bool isByteStream(const TargetStreamType type) {
+                    return (type == TargetStreamType::STREAM_SERIAL) || (type == TargetStreamType::STREAM_FD)
+                        || (type == TargetStreamType::STREAM_TCP);
+                }
+
+                static bool canFrame(const size_t size) {
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+                    (void)size;
+                    return true;
+#else
+                    return detail::frame_size(size) <= PACKETIZER_MAX_PACKET_BINARY_SIZE;
+#endif
+                }
+            };
+
+        }  // namespace router
+
+        // forward frames of the index received from `src` to `dst` (with `dst_index` if given)
+        // frames are written on the thread which parses `src`, serialized with `post()`
+        template <typename S, typename D>
+        inline void route(S& src, const uint8_t index, D& dst, const uint8_t dst_index) {
+            const DecodeTargetStream target = UnpackerManager::getInstance().getDecodeTargetStream(dst);
+            router::Router::getInstance().add(src, index, Destination(*target.stream, target.type, dst_index));
+        }
+
+        template <typename S, typename D>
+        inline void route(S& src, const uint8_t index, D& dst) {
+            route(src, index, dst, index);
+        }
+
+#ifdef MSGPACKETIZER_ENABLE_NETWORK
+
+        template <typename S>
+        inline void route(
+            S& src,
+            const uint8_t index,
+            UDP& dst,
+            const str_t& ip,
+            const uint16_t port,
+            const uint8_t dst_index) {
+            const DecodeTargetStream target = UnpackerManager::getInstance().getDecodeTargetStream(dst);
+            const Destination dest(*target.stream, target.type, dst_index, ip, port);
+            router::Router::getInstance().add(src, index, dest);
+        }
+
+        template <typename S>
+        inline void route(S& src, const uint8_t index, UDP& dst, const str_t& ip, const uint16_t port) {
+            route(src, index, dst, ip, port, index);
+        }
+
+#endif  // MSGPACKETIZER_ENABLE_NETWORK
+
+        // remove routes of the index from the stream
+        template <typename S>
+        inline void unroute(const S& src, const uint8_t index) {
+            const DecodeTargetStream target = UnpackerManager::getInstance().getDecodeTargetStream(src);
+            router::Router::getInstance().remove(target, index, false);
+        }
+
+        // remove all routes from the stream
+        template <typename S>
+        inline void unroute(const S& src) {
+            const DecodeTargetStream target = UnpackerManager::getInstance().getDecodeTargetStream(src);
+            router::Router::getInstance().remove(target, 0, true);
+        }
+
+    }  // namespace msgpacketizer
+}  // namespace msgpack
+}  // namespace arduino
+
+#endif  // MSGPACKETIZER_ENABLE_STREAM
+
+#endif  // HT_SERIAL_MSGPACKETIZER_ROUTER_H
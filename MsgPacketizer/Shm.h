@@ -0,0 +1,291 @@
+#pragma once
+
+#ifndef HT_SERIAL_MSGPACKETIZER_SHM_H
+#define HT_SERIAL_MSGPACKETIZER_SHM_H
+
+#ifdef MSGPACKETIZER_ENABLE_SHM
+
+// default ring size in bytes (must be power of two)
+#ifndef MSGPACKETIZER_SHM_CAPACITY
+#define MSGPACKETIZER_SHM_CAPACITY (1024 * 1024)
+#endif
+
+namespace arduino {
+namespace msgpack {
+    namespace msgpacketizer {
+
+        namespace posix {
+
+            // Single-producer multi-consumer ring of msgpack payloads in POSIX shared memory.
+            // Records are [size][index][payload] without COBS and CRC. Consumers copy every record
+            // out of the mapped ring and validate it against the head of the producer afterwards (like seqlock),
+            // so callbacks never see payloads which are being overwritten. With setZeroCopy(true), callbacks get
+            // the payload in the ring itself after it is validated, and the record is validated again when they
+            // return: if the producer lapped it meanwhile, the callback may have seen torn data (see torn()).
+            // Every consumer has its own read position, and one which lags behind by more than half of the ring
+            // skips to the newest record.
+            class SharedMemory {
+                static constexpr uint32_t MAGIC {0x4D50534D};  // "MPSM"
+                static constexpr uint32_t PADDING {0xFFFFFFFF};
+
+                struct Header {
+                    std::atomic<uint32_t> magic;
+                    uint32_t capacity;
+                    std::atomic<uint64_t> head;  // total bytes written by the producer
+                    std::atomic<uint32_t> seq;   // futex word, incremented for every record
+                    uint8_t reserved0[44];
+                    std::atomic<uint32_t> n_waiters;  // written by consumers, on another cache line
+                    uint8_t reserved1[60];
+                };
+
+                struct Record {
+                    uint32_t size;
+                    uint8_t index;
+                    uint8_t reserved[3];
+                };
+
+                Header* header {nullptr};
+                uint8_t* ring {nullptr};
+                size_t map_size {0};
+                uint64_t tail {0};
+                uint32_t n_overruns {0};
+                uint32_t n_torn {0};
+                codec::Buffer record;  // payload copied out of the ring
+                bool b_producer {false};
+                bool b_zero_copy {false};
+                str_t name;
+
+            public:
+                SharedMemory() {}
+                SharedMemory(const SharedMemory&) = delete;
+                SharedMemory& operator=(const SharedMemory&) = delete;
+                ~SharedMemory() {
+                    close();
+                }
+
+                // create a new ring as its only producer
+                // existing ring of the same name is replaced (consumers should open it again)
+                bool create(const char* shm_name, const size_t capacity = MSGPACKETIZER_SHM_CAPACITY) {
+                    close();
+                    if ((capacity < 2 * sizeof(Record)) || (capacity & (capacity - 1))) {
+                        LOG_ERROR(F("capacity of shared memory must be power of two"));
+                        return false;
+                    }
+                    ::shm_unlink(shm_name);
+                    const int fd = ::shm_open(shm_name, O_CREAT | O_EXCL | O_RDWR, 0666);
+                    if (fd < 0) {
+                        LOG_ERROR(F("cannot create shared memory: "), shm_name);
+                        return false;
+                    }
+                    const bool b_ok = (::ftruncate(fd, (off_t)(sizeof(Header) + capacity)) == 0)
+                                   && map(fd, sizeof(Header) + capacity);
+                    ::close(fd);
+                    if (!b_ok) {
+                        ::shm_unlink(shm_name);
+                        return false;
+                    }
+                    new (header) Header();
+                    header->capacity = (uint32_t)capacity;
+                    header->magic.store(MAGIC, std::memory_order_release);
+                    b_producer = true;
+                    name = shm_name;
+                    return true;
+                }
+
+                // open an existing ring as a consumer, only records written after this are read
+                bool open(const char* shm_name) {
+                    close();
+                    const int fd = ::shm_open(shm_name, O_RDWR, 0666);
+                    if (fd < 0) {
+                        LOG_ERROR(F("cannot open shared memory: "), shm_name);
+                        return false;
+                    }
+                    struct stat st;
+                    const bool b_ok = (::fstat(fd, &st) == 0) && ((size_t)st.st_size > sizeof(Header))
+                                   && map(fd, (size_t)st.st_size);
+                    ::close(fd);
+                    if (!b_ok) return false;
+                    if ((header->magic.load(std::memory_order_acquire) != MAGIC)
+                        || (sizeof(Header) + header->capacity != map_size)) {
+                        LOG_ERROR(F("shared memory is not initialized: "), shm_name);
+                        close();
+                        return false;
+                    }
+                    tail = header->head.load(std::memory_order_acquire);
+                    name = shm_name;
+                    return true;
+                }
+
+                // the producer also removes the name of the ring
+                void close() {
+                    if (header) ::munmap(header, map_size);
+                    if (b_producer) ::shm_unlink(name.c_str());
+                    header = nullptr;
+                    ring = nullptr;
+                    map_size = 0;
+                    b_producer = false;
+                }
+
+                bool isOpen() const {
+                    return header != nullptr;
+                }
+
+                bool isProducer() const {
+                    return b_producer;
+                }
+
+                // write one record and wake up waiting consumers
+                size_t send(const uint8_t index, const uint8_t* data, const size_t size) {
+                    trace::Scope scope(trace::WRITE, index);
+                    if (!b_producer) {
+                        LOG_ERROR(F("only the producer can write to shared memory"));
+                        return 0;
+                    }
+                    const size_t capacity = header->capacity;
+                    const size_t len = align(sizeof(Record) + size);
+                    if (len > capacity / 2) {
+                        LOG_ERROR(F("packet is too large for shared memory: "), size);
+                        return 0;
+                    }
+                    uint64_t head = header->head.load(std::memory_order_relaxed);
+                    size_t pos = (size_t)(head & (capacity - 1));
+                    if (pos + len > capacity) {
+                        reinterpret_cast<Record*>(ring + pos)->size = PADDING;
+                        head += capacity - pos;
+                        pos = 0;
+                        // publish padding first so that bytes being written never exceed half of the ring
+                        header->head.store(head, std::memory_order_release);
+                    }
+                    Record* r = reinterpret_cast<Record*>(ring + pos);
+                    r->size = (uint32_t)size;
+                    r->index = index;
+                    std::memcpy(ring + pos + sizeof(Record), data, size);
+                    header->head.store(head + len, std::memory_order_release);
+                    header->seq.fetch_add(1);
+                    if (header->n_waiters.load()) futex(FUTEX_WAKE, INT32_MAX, nullptr);
+                    return size;
+                }
+
+                // `callback(index, data, size)` is called for every new record with a copy of its payload
+                // (or the payload in the ring with setZeroCopy(true)), returns the number of bytes consumed
+                template <typename F>
+                size_t read(F&& callback) {
+                    if (!header || b_producer) return 0;
+                    const size_t capacity = header->capacity;
+                    const uint64_t head = header->head.load(std::memory_order_acquire);
+                    if (lapped()) return 0;
+                    const uint64_t begin = tail;
+                    while (tail < head) {
+                        const size_t pos = (size_t)(tail & (capacity - 1));
+                        const Record r = *reinterpret_cast<const Record*>(ring + pos);
+                        if (lapped()) break;
+                        if (r.size == PADDING) {
+                            tail += capacity - pos;
+                            continue;
+                        }
+                        if (sizeof(Record) + (size_t)r.size > capacity - pos) {
+                            LOG_ERROR(F("broken record in shared memory: "), r.size);
+                            ++n_overruns;
+                            tail = header->head.load(std::memory_order_acquire);
+                            break;
+                        }
+                        if (b_zero_copy) {
+                            // validated above, `tail` stays at the record to validate it again after the callback
+                            callback(r.index, ring + pos + sizeof(Record), (size_t)r.size);
+                            if (lapped()) {
+                                ++n_torn;
+                                break;
+                            }
+                            tail += align(sizeof(Record) + r.size);
+                            continue;
+                        }
+                        record.resize(r.size);
+                        std::memcpy(record.data(), ring + pos + sizeof(Record), r.size);
+                        if (lapped()) break;
+                        tail += align(sizeof(Record) + r.size);
+                        callback(r.index, record.data(), record.size());
+                    }
+                    return (size_t)(tail - begin);
+                }
+
+                // block until new records are written or timeout
+                bool wait(const uint32_t timeout_us) {
+                    if (!header || b_producer) return false;
+                    if (header->head.load(std::memory_order_acquire) != tail) return true;
+                    const uint32_t seq = header->seq.load();
+                    if (header->head.load(std::memory_order_acquire) != tail) return true;
+                    timespec ts;
+                    ts.tv_sec = timeout_us / 1000000;
+                    ts.tv_nsec = (timeout_us % 1000000) * 1000;
+                    header->n_waiters.fetch_add(1);
+                    futex(FUTEX_WAIT, seq, &ts);
+                    header->n_waiters.fetch_sub(1);
+                    return header->head.load(std::memory_order_acquire) != tail;
+                }
+
+                // number of times this consumer lagged behind and skipped records
+                uint32_t overruns() const {
+                    return n_overruns;
+                }
+
+                // dispatch payloads in the ring without copying them (only for consumers)
+                // callbacks must be faster than the producer fills half of the ring, otherwise they may see
+                // payloads being overwritten. Such records are counted by torn() and the consumer skips ahead.
+                void setZeroCopy(const bool b) {
+                    b_zero_copy = b;
+                }
+
+                bool isZeroCopy() const {
+                    return b_zero_copy;
+                }
+
+                // number of records whose payload was overwritten while the callback saw it in place
+                uint32_t torn() const {
+                    return n_torn;
+                }
+
+            private:
+                // bytes from `tail` may be overwritten if the producer is more than half of the ring ahead
+                // (a record being written is at most half of the ring), then skip to the newest record
+                bool lapped() {
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    const uint64_t head = header->head.load(std::memory_order_acquire);
+                    if (head - tail <= header->capacity / 2) return false;
+                    ++n_overruns;
+                    tail = head;
+                    return true;
+                }
+
+                static size_t align(const size_t size) {
+                    return (size + 7) & ~(size_t)7;
+                }
+
+                bool map(const int fd, const size_t size) {
+                    void* addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                    if (addr == MAP_FAILED) return false;
+                    header = reinterpret_cast<Header*>(addr);
+                    ring = reinterpret_cast<uint8_t*>(addr) + sizeof(Header);
+                    map_size = size;
+                    return true;
+                }
+
+                // futex of shared mapping (not FUTEX_PRIVATE_FLAG)
+                long futex(const int op, const uint32_t val, const timespec* ts) {
+                    return ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&header->seq), op, val, ts, nullptr, 0);
+                }
+            };
+
+        }  // namespace posix
+
+        namespace detail {
+            template <>
+            struct is_posix_stream<posix::SharedMemory> : std::true_type {};
+        }  // namespace detail
+
+    }  // namespace msgpacketizer
+}  // namespace msgpack
+}  // namespace arduino
+
+#endif  // MSGPACKETIZER_ENABLE_SHM
+
+#endif  // HT_SERIAL_MSGPACKETIZER_SHM_H
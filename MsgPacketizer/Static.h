@@ -0,0 +1,188 @@
+#pragma once
+
+#ifndef HT_SERIAL_MSGPACKETIZER_STATIC_H
+#define HT_SERIAL_MSGPACKETIZER_STATIC_H
+
+namespace arduino {
+namespace msgpack {
+    namespace msgpacketizer {
+
+        // Topics declared at compile time as template arguments (C++11, no STL required).
+        // fixed::Publisher and fixed::Subscriber have no maps, shared_ptr, std::function or virtual functions:
+        // encoding and dispatching of every index are unrolled by templates, and the only runtime state
+        // is the last publish time of each topic and buffers of one packet.
+        namespace fixed {
+
+            // variable which is published and / or subscribed with the index
+            template <uint8_t Index, typename T, T* Value, uint32_t IntervalUsec = 33333>
+            struct Topic {
+                static constexpr uint8_t index {Index};
+                static constexpr uint32_t interval_us {IntervalUsec};
+
+                static void encode(MsgPack::Packer& p) {
+                    p.serialize(*Value);
+                }
+                static bool decode(MsgPack::Unpacker& u) {
+                    return u.deserialize(*Value);
+                }
+            };
+
+            // function called with the value received with the index
+            template <uint8_t Index, typename T, void (*Callback)(const T&)>
+            struct Handler {
+                static constexpr uint8_t index {Index};
+
+                static bool decode(MsgPack::Unpacker& u) {
+                    T value;
+                    if (!u.deserialize(value)) return false;
+                    Callback(value);
+                    return true;
+                }
+            };
+
+            namespace meta {
+                template <uint8_t Index, typename... Ts>
+                struct has_index : std::false_type {};
+                template <uint8_t Index, typename T, typename... Ts>
+                struct has_index<Index, T, Ts...>
+                : std::integral_constant<bool, (T::index == Index) || has_index<Index, Ts...>::value> {};
+
+                template <typename... Ts>
+                struct unique_index : std::true_type {};
+                template <typename T, typename... Ts>
+                struct unique_index<T, Ts...>
+                : std::integral_constant<bool, !has_index<T::index, Ts...>::value && unique_index<Ts...>::value> {};
+
+#ifdef MSGPACKETIZER_ENABLE_STREAM
+                // read available bytes without blocking
+                template <typename S>
+                inline size_t read(S& stream, uint8_t* buffer, const size_t size) {
+                    const int available = (int)stream.available();
+                    if (available <= 0) return 0;
+                    const size_t n = ((size_t)available < size) ? (size_t)available : size;
+#ifdef ARDUINO
+                    return stream.readBytes(buffer, n);
+#elif defined(OF_VERSION_MAJOR)
+                    const long r = stream.readBytes(buffer, n);
+                    return (r > 0) ? (size_t)r : 0;
+#else
+                    const int r = (int)stream.read(buffer, n);
+                    return (r > 0) ? (size_t)r : 0;
+#endif
+                }
+#endif  // MSGPACKETIZER_ENABLE_STREAM
+            }  // namespace meta
+
+#ifdef MSGPACKETIZER_ENABLE_STREAM
+
+            template <typename S, typename... Topics>
+            class Publisher {
+                static_assert(sizeof...(Topics) > 0, "at least one topic is required");
+                static_assert(meta::unique_index<Topics...>::value, "index of topics must be unique");
+
+                S& stream;
+                MsgPack::Packer packer;
+                uint32_t last_us[sizeof...(Topics)];
+
+            public:
+                explicit Publisher(S& stream) : stream(stream), last_us {} {}
+
+                // send topics whose interval has elapsed
+                void post() {
+                    post_each<0, Topics...>(MSGPACKETIZER_ELAPSED_MICROS());
+                }
+
+                // send the topic of the index now, returns false if there is no such topic
+                bool send(const uint8_t index) {
+                    return send_each<0, Topics...>(index);
+                }
+
+            private:
+                template <size_t I>
+                void post_each(const uint32_t) {}
+                template <size_t I, typename T, typename... Ts>
+                void post_each(const uint32_t now) {
+                    if ((uint32_t)(now - last_us[I]) >= T::interval_us) {
+                        write<T>();
+                        last_us[I] = now;
+                    }
+                    post_each<I + 1, Ts...>(now);
+                }
+
+                template <size_t I>
+                bool send_each(const uint8_t) {
+                    return false;
+                }
+                template <size_t I, typename T, typename... Ts>
+                bool send_each(const uint8_t index) {
+                    if (index != T::index) return send_each<I + 1, Ts...>(index);
+                    write<T>();
+                    return true;
+                }
+
+                template <typename T>
+                void write() {
+                    packer.clear();
+                    T::encode(packer);
+                    detail::send_frame(stream, T::index, packer.data(), packer.size());
+                }
+            };
+
+#endif  // MSGPACKETIZER_ENABLE_STREAM
+
+            template <typename... Topics>
+            class Subscriber {
+                static_assert(sizeof...(Topics) > 0, "at least one topic is required");
+                static_assert(meta::unique_index<Topics...>::value, "index of topics must be unique");
+
+                codec::Decoder decoder;
+                MsgPack::Unpacker unpacker;
+
+            public:
+#ifdef MSGPACKETIZER_ENABLE_STREAM
+                // read available bytes from the stream and dispatch received packets
+                template <typename S>
+                void parse(S& stream) {
+                    uint8_t buffer[16];
+                    size_t n = 0;
+                    while ((n = meta::read(stream, buffer, sizeof(buffer))) > 0) feed(buffer, n);
+                }
+#endif
+
+                // decode bytes received manually
+                void feed(const uint8_t* data, const size_t size) {
+                    decoder.feed(data, size, [this](const uint8_t index, const uint8_t* d, const size_t n) {
+                        dispatch(index, d, n);
+                    });
+                }
+
+                // returns false if there is no topic of the index or the payload cannot be decoded
+                bool dispatch(const uint8_t index, const uint8_t* data, const size_t size) {
+                    unpacker.clear();
+                    unpacker.feed(data, size);
+                    return dispatch_each<0, Topics...>(index);
+                }
+
+                // number of frames dropped because of COBS or CRC errors
+                uint32_t errors() const {
+                    return decoder.errors();
+                }
+
+            private:
+                template <size_t I>
+                bool dispatch_each(const uint8_t) {
+                    return false;
+                }
+                template <size_t I, typename T, typename... Ts>
+                bool dispatch_each(const uint8_t index) {
+                    return (index == T::index) ? T::decode(unpacker) : dispatch_each<I + 1, Ts...>(index);
+                }
+            };
+
+        }  // namespace fixed
+
+    }  // namespace msgpacketizer
+}  // namespace msgpack
+}  // namespace arduino
+
+#endif  // HT_SERIAL_MSGPACKETIZER_STATIC_H
@@ -0,0 +1,245 @@
+#pragma once
+
+#ifndef HT_SERIAL_MSGPACKETIZER_STATS_H
+#define HT_SERIAL_MSGPACKETIZER_STATS_H
+
+#if defined(MSGPACKETIZER_ENABLE_STREAM) && defined(MSGPACKETIZER_ENABLE_STATS)
+
+namespace arduino {
+namespace msgpack {
+    namespace msgpacketizer {
+
+        // Runtime counters of every stream and index.
+        // All counters are relaxed atomics updated by the thread which sends or dispatches the frame,
+        // so they can be read at any time from any thread without stopping communication.
+        namespace stats {
+
+            // callback durations in log2 buckets of usec: [0, 1), [1, 2), [2, 4), ... [16384, inf)
+            static constexpr size_t HISTOGRAM_SIZE {16};
+
+            using Clock = std::chrono::steady_clock;
+
+            struct Counter {
+                std::atomic<uint64_t> v {0};
+
+                void add(const uint64_t n) {
+                    v.fetch_add(n, std::memory_order_relaxed);
+                }
+                uint64_t get() const {
+                    return v.load(std::memory_order_relaxed);
+                }
+                void reset() {
+                    v.store(0, std::memory_order_relaxed);
+                }
+            };
+
+            inline uint64_t elapsed_ns(const Clock::time_point& begin) {
+                return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count();
+            }
+
+            inline size_t histogram_bucket(uint64_t us) {
+                size_t b = 0;
+                while (us && (b < HISTOGRAM_SIZE - 1)) {
+                    ++b;
+                    us >>= 1;
+                }
+                return b;
+            }
+
+            // copy of counters of one index
+            struct IndexSnapshot {
+                uint64_t tx_frames {0};
+                uint64_t tx_bytes {0};     // msgpack payload bytes (fragments include their header)
+                uint64_t tx_deferred {0};  // publishes deferred by link budget or unfinished fragments
+                uint64_t encode_ns {0};    // total time of encoding published elements
+                uint64_t rx_frames {0};
+                uint64_t rx_bytes {0};
+                uint64_t rx_unhandled {0};  // frames without subscriber
+                uint64_t callback_ns {0};   // total time in subscriber callbacks (including unpacking)
+                uint64_t callback_us_histogram[HISTOGRAM_SIZE] {};
+            };
+
+            struct IndexStats {
+                Counter tx_frames, tx_bytes, tx_deferred, encode_ns;
+                Counter rx_frames, rx_bytes, rx_unhandled, callback_ns;
+                Counter callback_us_histogram[HISTOGRAM_SIZE];
+
+                IndexSnapshot snapshot() const {
+                    IndexSnapshot s;
+                    s.tx_frames = tx_frames.get();
+                    s.tx_bytes = tx_bytes.get();
+                    s.tx_deferred = tx_deferred.get();
+                    s.encode_ns = encode_ns.get();
+                    s.rx_frames = rx_frames.get();
+                    s.rx_bytes = rx_bytes.get();
+                    s.rx_unhandled = rx_unhandled.get();
+                    s.callback_ns = callback_ns.get();
+                    for (size_t i = 0; i < HISTOGRAM_SIZE; ++i)
+                        s.callback_us_histogram[i] = callback_us_histogram[i].get();
+                    return s;
+                }
+
+                void reset() {
+                    tx_frames.reset();
+                    tx_bytes.reset();
+                    tx_deferred.reset();
+                    encode_ns.reset();
+                    rx_frames.reset();
+                    rx_bytes.reset();
+                    rx_unhandled.reset();
+                    callback_ns.reset();
+                    for (auto& h : callback_us_histogram) h.reset();
+                }
+            };
+
+            // copy of counters of one stream, totals are summed over indices
+            struct StreamSnapshot {
+                uint64_t tx_frames {0};
+                uint64_t tx_bytes {0};
+                uint64_t rx_frames {0};
+                uint64_t rx_bytes {0};
+                uint64_t decode_errors {0};   // COBS / CRC errors (only for streams not read by Packetizer)
+                uint64_t fragment_drops {0};  // fragmented messages which could not be reassembled
+                std::map<uint8_t, IndexSnapshot> indices;
+            };
+
+            class StreamStats {
+                std::atomic<IndexStats*> indices[256];
+
+            public:
+                Counter decode_errors;
+                Counter fragment_drops;
+
+                StreamStats() {
+                    for (auto& i : indices) i.store(nullptr, std::memory_order_relaxed);
+                }
+                StreamStats(const StreamStats&) = delete;
+                StreamStats& operator=(const StreamStats&) = delete;
+                ~StreamStats() {
+                    for (auto& i : indices) delete i.load();
+                }
+
+                // counters of the index are allocated when it is used first
+                IndexStats& index(const uint8_t i) {
+                    IndexStats* s = indices[i].load(std::memory_order_acquire);
+                    if (s) return *s;
+                    IndexStats* created = new IndexStats();
+                    if (indices[i].compare_exchange_strong(s, created, std::memory_order_acq_rel)) return *created;
+                    delete created;  // created by another thread
+                    return *s;
+                }
+
+                void sent(const uint8_t i, const size_t size) {
+                    IndexStats& s = index(i);
+                    s.tx_frames.add(1);
+                    s.tx_bytes.add(size);
+                }
+
+                void received(const uint8_t i, const size_t size) {
+                    IndexStats& s = index(i);
+                    s.rx_frames.add(1);
+                    s.rx_bytes.add(size);
+                }
+
+                void called(const uint8_t i, const uint64_t ns) {
+                    IndexStats& s = index(i);
+                    s.callback_ns.add(ns);
+                    s.callback_us_histogram[histogram_bucket(ns / 1000)].add(1);
+                }
+
+                StreamSnapshot snapshot() const {
+                    StreamSnapshot snap;
+                    snap.decode_errors = decode_errors.get();
+                    snap.fragment_drops = fragment_drops.get();
+                    for (size_t i = 0; i < 256; ++i) {
+                        const IndexStats* s = indices[i].load(std::memory_order_acquire);
+                        if (!s) continue;
+                        const IndexSnapshot is = s->snapshot();
+                        snap.tx_frames += is.tx_frames;
+                        snap.tx_bytes += is.tx_bytes;
+                        snap.rx_frames += is.rx_frames;
+                        snap.rx_bytes += is.rx_bytes;
+                        snap.indices[(uint8_t)i] = is;
+                    }
+                    return snap;
+                }
+
+                void reset() {
+                    decode_errors.reset();
+                    fragment_drops.reset();
+                    for (auto& i : indices) {
+                        IndexStats* s = i.load(std::memory_order_acquire);
+                        if (s) s->reset();
+                    }
+                }
+            };
+
+            // owns StreamStats of all streams, which live until the end of the program
+            class Registry {
+                Registry() {}
+                Registry(const Registry&) = delete;
+                Registry& operator=(const Registry&) = delete;
+
+                std::map<const void*, std::unique_ptr<StreamStats>> streams;
+                mutable std::mutex mtx;
+
+            public:
+                static Registry& getInstance() {
+                    static Registry r;
+                    return r;
+                }
+
+                // the last stream used by the thread is cached to avoid locking for every frame
+                StreamStats& get(const void* stream) {
+                    thread_local const void* last_stream {nullptr};
+                    thread_local StreamStats* last {nullptr};
+                    if (last && (last_stream == stream)) return *last;
+                    std::lock_guard<std::mutex> lock(mtx);
+                    auto& s = streams[stream];
+                    if (!s) s.reset(new StreamStats());
+                    last_stream = stream;
+                    last = s.get();
+                    return *last;
+                }
+
+                std::map<const void*, StreamSnapshot> snapshot() const {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    std::map<const void*, StreamSnapshot> snaps;
+                    for (auto& s : streams) snaps[s.first] = s.second->snapshot();
+                    return snaps;
+                }
+
+                void reset() {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    for (auto& s : streams) s.second->reset();
+                }
+            };
+
+        }  // namespace stats
+
+        template <typename S>
+        inline stats::StreamSnapshot getStats(const S& stream) {
+            return stats::Registry::getInstance().get(&stream).snapshot();
+        }
+
+        // snapshots of all streams which sent or received frames, keyed by the address of the stream
+        inline std::map<const void*, stats::StreamSnapshot> getStats() {
+            return stats::Registry::getInstance().snapshot();
+        }
+
+        template <typename S>
+        inline void resetStats(const S& stream) {
+            stats::Registry::getInstance().get(&stream).reset();
+        }
+
+        inline void resetStats() {
+            stats::Registry::getInstance().reset();
+        }
+
+    }  // namespace msgpacketizer
+}  // namespace msgpack
+}  // namespace arduino
+
+#endif  // MSGPACKETIZER_ENABLE_STREAM && MSGPACKETIZER_ENABLE_STATS
+
+#endif  // HT_SERIAL_MSGPACKETIZER_STATS_H
@@ -9,15 +9,48 @@ namespace msgpack {
 
         struct DecodeTargetStream;
         using UnpackerRef = std::shared_ptr<MsgPack::Unpacker>;
+        class Receiver;
+        using ReceiverRef = std::shared_ptr<Receiver>;
 
 #ifdef MSGPACKETIZER_ENABLE_STREAM
+        // receiver referred by SubscribeHandle, the slot is reused after the receiver is removed
+        struct ReceiverSlot {
+            ReceiverRef receiver;     // nullptr if the slot is free
+            uint16_t generation {1};  // incremented when the slot is freed, never 0
+        };
+
 #if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
         using UnpackerMap = std::map<DecodeTargetStream, UnpackerRef>;
+        using ReceiverMap = std::map<DecodeTargetStream, ReceiverRef>;
+        using ReceiverSlotList = std::vector<ReceiverSlot>;
 #else
         using UnpackerMap = arx::stdx::map<DecodeTargetStream, UnpackerRef, PACKETIZER_MAX_STREAM_MAP_SIZE>;
+        using ReceiverMap = arx::stdx::map<DecodeTargetStream, ReceiverRef, PACKETIZER_MAX_STREAM_MAP_SIZE>;
+        using ReceiverSlotList = arx::stdx::vector<ReceiverSlot, PACKETIZER_MAX_STREAM_MAP_SIZE>;
+#endif
+#endif  // MSGPACKETIZER_ENABLE_STREAM
+
+#ifdef MSGPACKETIZER_ENABLE_STREAM
+// stack buffer used when parse() reads streams by itself
+#ifndef MSGPACKETIZER_READ_BUFFER_SIZE
+#define MSGPACKETIZER_READ_BUFFER_SIZE 1024
+#endif
+// reads of one stream in one parse() so that continuous input does not starve other streams and post()
+#ifndef MSGPACKETIZER_MAX_READS_PER_PARSE
+#define MSGPACKETIZER_MAX_READS_PER_PARSE 16
 #endif
 #endif  // MSGPACKETIZER_ENABLE_STREAM
 
+// Receiver dispatches packets to index subscribers by itself only if some feature has to see them before.
+// Otherwise (e.g. NO-STL boards) index subscribers are registered to Packetizer directly as before,
+// and Receiver only holds subscribers of all indices and taps, which Packetizer forwards to it.
+#if defined(MSGPACKETIZER_ENABLE_POSIX) || defined(MSGPACKETIZER_ENABLE_THREAD)                 \
+    || defined(MSGPACKETIZER_ENABLE_FRAGMENT) || defined(MSGPACKETIZER_ENABLE_LATENCY)          \
+    || defined(MSGPACKETIZER_ENABLE_RELIABLE) || defined(MSGPACKETIZER_ENABLE_STATS)            \
+    || defined(MSGPACKETIZER_ENABLE_MEMORY_STATS)
+#define MSGPACKETIZER_ENABLE_RECEIVER_DISPATCH
+#endif
+
 #ifdef ARDUINOJSON_VERSION
 #ifndef MSGPACKETIZER_ARDUINOJSON_DESERIALIZE_BUFFER_SCALE
 #define MSGPACKETIZER_ARDUINOJSON_DESERIALIZE_BUFFER_SCALE 3
@@ -58,6 +91,478 @@ namespace msgpack {
             }
         };
 
+        namespace detail {
+            // read bytes which are already available without blocking
+            inline size_t read_bytes(const DecodeTargetStream& s, uint8_t* buffer, const size_t size) {
+                switch (s.type) {
+#ifdef MSGPACKETIZER_ENABLE_PACKETIZER_STREAM
+                    case TargetStreamType::STREAM_SERIAL: {
+                        const int n = (int)s.stream->available();
+                        if (n <= 0) return 0;
+                        const size_t len = ((size_t)n < size) ? (size_t)n : size;
+#ifdef ARDUINO
+                        return s.stream->readBytes((char*)buffer, len);
+#elif defined(OF_VERSION_MAJOR)
+                        return (size_t)s.stream->readBytes(buffer, len);
+#elif defined(SERIAL_H)
+                        return s.stream->read(buffer, len);
+#endif
+                    }
+#endif
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+                    case TargetStreamType::STREAM_FD: {
+                        const int n = reinterpret_cast<posix::Stream*>(s.stream)->read(buffer, size);
+                        return (n > 0) ? (size_t)n : 0;
+                    }
+#endif
+#ifdef MSGPACKETIZER_ENABLE_NETWORK
+                    case TargetStreamType::STREAM_UDP: {
+                        UDP* udp = reinterpret_cast<UDP*>(s.stream);
+                        if ((udp->available() <= 0) && (udp->parsePacket() <= 0)) return 0;
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+                        // one datagram at a time so that its frames are dispatched with its sender
+                        const int n = udp->readDatagram(buffer, size);
+#else
+                        const int n = udp->read(buffer, size);
+#endif
+                        return (n > 0) ? (size_t)n : 0;
+                    }
+                    case TargetStreamType::STREAM_TCP: {
+                        Client* client = reinterpret_cast<Client*>(s.stream);
+                        if (client->available() <= 0) return 0;
+                        const int n = client->read(buffer, size);
+                        return (n > 0) ? (size_t)n : 0;
+                    }
+#endif
+                    default:
+                        LOG_ERROR(F("This communication I/F is not supported"));
+                        return 0;
+                }
+            }
+
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+            // bytes of a received UDP batch are left in memory and can be read without new input
+            inline bool buffered(const DecodeTargetStream& s) {
+#ifdef MSGPACKETIZER_ENABLE_NETWORK
+                if (s.type == TargetStreamType::STREAM_UDP) return reinterpret_cast<UDP*>(s.stream)->available() > 0;
+#endif
+                (void)s;
+                return false;
+            }
+#endif
+
+            // sender of the datagram being decoded (see latency::peer()), 0 for point-to-point streams
+            inline uint64_t remote_peer(const DecodeTargetStream& s) {
+#ifdef MSGPACKETIZER_ENABLE_NETWORK
+                if (s.type == TargetStreamType::STREAM_UDP) {
+                    UDP* udp = reinterpret_cast<UDP*>(s.stream);
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+                    return latency::peer(udp->remoteAddr(), udp->remotePort());
+#else
+                    const IPAddress ip = udp->remoteIP();
+                    const uint32_t addr =
+                        ((uint32_t)ip[0] << 24) | ((uint32_t)ip[1] << 16) | ((uint32_t)ip[2] << 8) | (uint32_t)ip[3];
+                    return latency::peer(addr, udp->remotePort());
+#endif
+                }
+#endif
+                (void)s;
+                return 0;
+            }
+        }  // namespace detail
+
+        // who reads bytes from the stream of Receiver
+        enum class ReaderType : uint8_t {
+            PACKETIZER,  // Packetizer::parse() reads and decodes, then forwards packets to Receiver
+            WORKER,      // Worker thread reads and decodes by itself
+            PARSE,       // parse() reads and decodes by itself (posix streams which Packetizer does not know)
+        };
+
+        // Returned by subscribe(). It is the slot number and generation of the receiver of the stream
+        // and the subscribed index, so unsubscribe(handle) does not look up the stream.
+        // The handle is invalid after all subscribers of the stream are removed by unsubscribe(stream).
+        class SubscribeHandle {
+            uint16_t slot {0};
+            uint16_t generation {0};  // 0: invalid
+            uint8_t index {0};
+            bool b_all {false};  // subscribed to all indices
+
+        public:
+            SubscribeHandle() {}
+            SubscribeHandle(const uint16_t slot, const uint16_t generation, const uint8_t index, const bool b_all)
+            : slot(slot), generation(generation), index(index), b_all(b_all) {}
+
+            uint16_t getSlot() const {
+                return slot;
+            }
+            uint16_t getGeneration() const {
+                return generation;
+            }
+            uint8_t getIndex() const {
+                return index;
+            }
+            bool isAll() const {
+                return b_all;
+            }
+            explicit operator bool() const {
+                return generation != 0;
+            }
+
+            bool operator==(const SubscribeHandle& rhs) const {
+                return (slot == rhs.slot) && (generation == rhs.generation) && (index == rhs.index)
+                    && (b_all == rhs.b_all);
+            }
+            bool operator!=(const SubscribeHandle& rhs) const {
+                return !(*this == rhs);
+            }
+        };
+
+        // holds subscribers of one stream and dispatches decoded packets to them
+        class Receiver {
+#if ARX_HAVE_LIBSTDCPLUSPLUS >= 201103L  // Have libstdc++11
+            using CallbackMap = std::map<uint8_t, Packetizer::CallbackType>;
+            using TapMap = std::map<const void*, Packetizer::CallbackAlwaysType>;
+#else
+            using CallbackMap = arx::stdx::map<uint8_t, Packetizer::CallbackType, PACKETIZER_MAX_CALLBACK_QUEUE_SIZE>;
+            using TapMap = arx::stdx::map<const void*, Packetizer::CallbackAlwaysType, MSGPACKETIZER_MAX_TAP_SIZE>;
+#endif
+
+            DecodeTargetStream target;
+            uint16_t slot {0};
+            uint16_t generation {0};
+            ReaderType reader {ReaderType::PACKETIZER};
+#ifdef MSGPACKETIZER_ENABLE_RECEIVER_DISPATCH
+            CallbackMap callbacks;
+#endif
+            Packetizer::CallbackAlwaysType callback_always;
+            TapMap taps;  // observers of all packets (e.g. recorder), independent from subscribers
+#ifdef MSGPACKETIZER_ENABLE_FRAGMENT
+            fragment::Reassembler reassembler;
+#endif
+#ifdef MSGPACKETIZER_ENABLE_STATS
+            stats::StreamStats& counters;
+#endif
+#if defined(MSGPACKETIZER_ENABLE_POSIX) || defined(MSGPACKETIZER_ENABLE_THREAD)
+            codec::Decoder framer;  // only for streams which are not read by Packetizer
+#endif
+            detail::Mutex mtx;
+
+#ifdef MSGPACKETIZER_ENABLE_THREAD
+            struct Frame {
+                uint8_t index;
+                uint64_t peer;
+                codec::Buffer data;
+            };
+            std::deque<Frame> pending;
+#endif
+
+        public:
+#ifdef MSGPACKETIZER_ENABLE_STATS
+            Receiver(const DecodeTargetStream& target)
+            : target(target), counters(stats::Registry::getInstance().get(target.stream)) {}
+#else
+            Receiver(const DecodeTargetStream& target) : target(target) {}
+#endif
+
+            const DecodeTargetStream& getTarget() const {
+                return target;
+            }
+
+            ReaderType getReaderType() const {
+                return reader;
+            }
+
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+            bool buffered() const {
+                return detail::buffered(target);
+            }
+#endif
+
+            void setReaderType(const ReaderType type) {
+                reader = type;
+            }
+
+            void setSlot(const uint16_t s, const uint16_t g) {
+                slot = s;
+                generation = g;
+            }
+
+            SubscribeHandle handle(const uint8_t index) const {
+                return SubscribeHandle(slot, generation, index, false);
+            }
+
+            SubscribeHandle handle() const {
+                return SubscribeHandle(slot, generation, 0, true);
+            }
+
+            void subscribe(const uint8_t index, const Packetizer::CallbackType& callback) {
+#ifdef MSGPACKETIZER_ENABLE_RECEIVER_DISPATCH
+                detail::LockGuard lock(mtx);
+                callbacks[index] = callback;
+#else
+                switch (target.type) {
+#ifdef MSGPACKETIZER_ENABLE_NETWORK
+                    case TargetStreamType::STREAM_UDP:
+                        Packetizer::subscribe(*reinterpret_cast<UDP*>(target.stream), index, callback);
+                        break;
+                    case TargetStreamType::STREAM_TCP:
+                        Packetizer::subscribe(*reinterpret_cast<Client*>(target.stream), index, callback);
+                        break;
+#endif
+                    default:
+                        Packetizer::subscribe(*target.stream, index, callback);
+                        break;
+                }
+#endif
+            }
+
+            void subscribe(const Packetizer::CallbackAlwaysType& callback) {
+                detail::LockGuard lock(mtx);
+                callback_always = callback;
+            }
+
+            void unsubscribe(const uint8_t index) {
+#ifdef MSGPACKETIZER_ENABLE_RECEIVER_DISPATCH
+                detail::LockGuard lock(mtx);
+                callbacks.erase(index);
+#else
+                switch (target.type) {
+#ifdef MSGPACKETIZER_ENABLE_NETWORK
+                    case TargetStreamType::STREAM_UDP:
+                        Packetizer::unsubscribe(*reinterpret_cast<UDP*>(target.stream), index);
+                        break;
+                    case TargetStreamType::STREAM_TCP:
+                        Packetizer::unsubscribe(*reinterpret_cast<Client*>(target.stream), index);
+                        break;
+#endif
+                    default:
+                        Packetizer::unsubscribe(*target.stream, index);
+                        break;
+                }
+#endif
+            }
+
+            void unsubscribeAlways() {
+                detail::LockGuard lock(mtx);
+                callback_always = nullptr;
+            }
+
+            // index subscribers kept by Packetizer are removed with the stream by unsubscribe(stream)
+            void unsubscribe() {
+                detail::LockGuard lock(mtx);
+#ifdef MSGPACKETIZER_ENABLE_RECEIVER_DISPATCH
+                callbacks.clear();
+#endif
+                callback_always = nullptr;
+            }
+
+            // `owner` is used as the key to remove the tap
+            void tap(const void* owner, const Packetizer::CallbackAlwaysType& callback) {
+                detail::LockGuard lock(mtx);
+                taps[owner] = callback;
+            }
+
+            void untap(const void* owner) {
+                detail::LockGuard lock(mtx);
+                taps.erase(owner);
+            }
+
+            // taps see fragments as received, subscribers see reassembled messages
+            // frames of reliable channels are ordered and unwrapped before them
+            void dispatch(const uint8_t index, const uint8_t* data, const size_t size) {
+                dispatch(index, data, size, detail::remote_peer(target));
+            }
+
+            // `peer` is the sender of UDP datagrams (see latency::peer())
+            void dispatch(const uint8_t index, const uint8_t* data, const size_t size, const uint64_t peer) {
+#ifdef MSGPACKETIZER_ENABLE_MEMORY_STATS
+                memory::Registry::getInstance().received(target.stream, index, detail::frame_size(size));
+#endif
+#ifdef MSGPACKETIZER_ENABLE_NETWORK
+                if ((target.type == TargetStreamType::STREAM_UDP)
+                    && (reliable::is_data(data, size) || reliable::is_ack(data, size))) {
+#ifdef MSGPACKETIZER_ENABLE_RELIABLE
+                    reliable::Registry::getInstance().receive(
+                        target.stream, index, peer, data, size, [this, index, peer](const uint8_t* d, const size_t n) {
+                            accept(index, d, n, peer);
+                        });
+#else
+                    // delivered without ordering and acks
+                    if (reliable::is_data(data, size))
+                        accept(index, data + reliable::DATA_HEADER_SIZE, size - reliable::DATA_HEADER_SIZE, peer);
+#endif
+                    return;
+                }
+#endif
+                accept(index, data, size, peer);
+            }
+
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+            // dispatch recorded frames (see capture::Replayer) below reliable channels and latency measurement
+            // so that replayed sequences, acks and stamps do not affect the live state of the stream
+            void replay(const uint8_t index, const uint8_t* data, size_t size) {
+#ifdef MSGPACKETIZER_ENABLE_NETWORK
+                if (reliable::is_ack(data, size)) return;
+                if (reliable::is_data(data, size)) {
+                    data += reliable::DATA_HEADER_SIZE;
+                    size -= reliable::DATA_HEADER_SIZE;
+                }
+#endif
+                accept(index, data, size, 0, false);
+            }
+#endif
+
+            // number of fragmented messages which could not be reassembled
+            uint32_t fragmentsDropped() {
+#ifdef MSGPACKETIZER_ENABLE_FRAGMENT
+                detail::LockGuard lock(mtx);
+                return reassembler.dropped();
+#else
+                return 0;
+#endif
+            }
+
+#ifdef MSGPACKETIZER_ENABLE_MEMORY_STATS
+            // add live bytes of subscribers and buffers to the footprint of the stream
+            void footprint(memory::StreamFootprint& sf) {
+                using namespace memory;
+                detail::LockGuard lock(mtx);
+                sf.receiver.add(sizeof(Receiver) + REF_OVERHEAD + map_bytes(callbacks) + map_bytes(taps));
+#ifdef MSGPACKETIZER_ENABLE_FRAGMENT
+                sf.receiver.add(reassembler.bytes());
+#endif
+#if defined(MSGPACKETIZER_ENABLE_POSIX) || defined(MSGPACKETIZER_ENABLE_THREAD)
+                sf.receiver.add(framer.bytes());
+#endif
+#ifdef MSGPACKETIZER_ENABLE_THREAD
+                for (auto& f : pending) sf.receiver.add(sizeof(Frame) + vector_bytes(f.data));
+#endif
+                for (auto& c : callbacks)
+                    sf.indices[c.first].subscriber.add(sizeof(typename CallbackMap::value_type) + NODE_OVERHEAD);
+            }
+#endif
+
+#if defined(MSGPACKETIZER_ENABLE_POSIX) || defined(MSGPACKETIZER_ENABLE_THREAD)
+            // read available bytes from the stream and decode them without Packetizer
+            // `callback(index, data, size)` is called for every decoded packet
+            template <typename F>
+            size_t read(uint8_t* buffer, const size_t size, F&& callback) {
+#ifdef MSGPACKETIZER_ENABLE_SHM
+                // records in shared memory are not framed and dispatched in place
+                if (target.type == TargetStreamType::STREAM_SHM)
+                    return reinterpret_cast<posix::SharedMemory*>(target.stream)->read(std::forward<F>(callback));
+#endif
+#ifdef MSGPACKETIZER_ENABLE_STATS
+                const uint32_t n_errors = framer.errors();
+#endif
+                size_t n = 0;
+                while (n < size) {
+                    size_t len = 0;
+                    {
+                        trace::Scope scope(trace::READ, 0);
+                        len = detail::read_bytes(target, buffer, size - n);
+                    }
+                    if (!len) break;
+                    framer.feed(buffer, len, callback);
+                    n += len;
+                    // datagrams are read one by one so that their frames are dispatched with their sender
+                    if (target.type != TargetStreamType::STREAM_UDP) break;
+                }
+#ifdef MSGPACKETIZER_ENABLE_STATS
+                if (framer.errors() != n_errors) counters.decode_errors.add(framer.errors() - n_errors);
+#endif
+                return n;
+            }
+#endif
+
+#ifdef MSGPACKETIZER_ENABLE_THREAD
+
+            // queue decoded packet to be dispatched later in deliver()
+            void post(const uint8_t index, const uint8_t* data, const size_t size) {
+                detail::LockGuard lock(mtx);
+                pending.emplace_back();
+                pending.back().index = index;
+                pending.back().peer = detail::remote_peer(target);
+                pending.back().data.assign(data, data + size);
+            }
+
+            // dispatch queued packets in received order
+            void deliver() {
+                std::deque<Frame> frames;
+                {
+                    detail::LockGuard lock(mtx);
+                    if (pending.empty()) return;
+                    frames.swap(pending);
+                }
+                for (auto& f : frames) dispatch(f.index, f.data.data(), f.data.size(), f.peer);
+            }
+
+#endif  // MSGPACKETIZER_ENABLE_THREAD
+
+        private:
+            void accept(
+                const uint8_t index,
+                const uint8_t* data,
+                const size_t size,
+                const uint64_t peer,
+                const bool b_live = true) {
+                trace::Scope scope(trace::DISPATCH, index);
+                detail::LockGuard lock(mtx);
+                for (auto& t : taps) t.second(index, data, size);
+#ifdef MSGPACKETIZER_ENABLE_STATS
+                counters.received(index, size);
+#endif
+#ifdef MSGPACKETIZER_ENABLE_FRAGMENT
+#ifdef MSGPACKETIZER_ENABLE_STATS
+                const uint32_t n_dropped = reassembler.dropped();
+#endif
+                const bool b_fragment = reassembler.feed(
+                    index, data, size, [this, peer, b_live](const uint8_t i, const uint8_t* d, const size_t n) {
+                        notify(i, d, n, peer, b_live);
+                    });
+#ifdef MSGPACKETIZER_ENABLE_STATS
+                if (reassembler.dropped() != n_dropped) counters.fragment_drops.add(reassembler.dropped() - n_dropped);
+#endif
+                if (!b_fragment) notify(index, data, size, peer, b_live);
+#else
+                notify(index, data, size, peer, b_live);
+#endif
+            }
+
+            void notify(
+                const uint8_t index,
+                const uint8_t* data,
+                size_t size,
+                const uint64_t peer,
+                const bool b_live) {
+                trace::Scope scope(trace::SUBSCRIBER, index);
+                if (latency::is_stamp(data, size)) {
+#ifdef MSGPACKETIZER_ENABLE_LATENCY
+                    if (b_live) latency::Registry::getInstance().receive(target.stream, peer, index, data);
+#else
+                    (void)peer;
+                    (void)b_live;
+#endif
+                    data += latency::HEADER_SIZE;
+                    size -= latency::HEADER_SIZE;
+                }
+#ifdef MSGPACKETIZER_ENABLE_STATS
+                const auto begin = stats::Clock::now();
+#endif
+                if (callback_always) callback_always(index, data, size);
+#ifdef MSGPACKETIZER_ENABLE_RECEIVER_DISPATCH
+                auto it = callbacks.find(index);
+                if (it != callbacks.end()) it->second(data, size);
+#endif
+#ifdef MSGPACKETIZER_ENABLE_STATS
+                if (!callback_always && (it == callbacks.end()))
+                    counters.index(index).rx_unhandled.add(1);
+                else
+                    counters.called(index, stats::elapsed_ns(begin));
+#endif
+            }
+        };
+
 #endif  // MSGPACKETIZER_ENABLE_STREAM
 
         class UnpackerManager {
@@ -68,6 +573,8 @@ namespace msgpack {
             UnpackerRef decoder;  // for non-stream usage
 #ifdef MSGPACKETIZER_ENABLE_STREAM
             UnpackerMap decoders;
+            ReceiverMap receivers;
+            ReceiverSlotList receiver_slots;
 #endif  // MSGPACKETIZER_ENABLE_STREAM
 
         public:
@@ -91,13 +598,99 @@ namespace msgpack {
                 return decoders;
             }
 
-            UnpackerRef getUnpackerRef(const StreamType& stream) {
+            template <typename S>
+            UnpackerRef getUnpackerRef(const S& stream) {
                 auto s = getDecodeTargetStream(stream);
                 if (decoders.find(s) == decoders.end())
                     decoders.insert(std::make_pair(s, std::make_shared<MsgPack::Unpacker>()));
                 return decoders[s];
             }
 
+            const ReceiverMap& getReceiverMap() const {
+                return receivers;
+            }
+
+            bool hasReceiver(const DecodeTargetStream& s) const {
+                return receivers.find(s) != receivers.end();
+            }
+
+            ReceiverRef getReceiverRef(const DecodeTargetStream& s) {
+                auto it = receivers.find(s);
+                if (it != receivers.end()) return it->second;
+                ReceiverRef receiver = std::make_shared<Receiver>(s);
+                size_t i = 0;
+                while ((i < receiver_slots.size()) && receiver_slots[i].receiver) ++i;
+                if (i == receiver_slots.size()) receiver_slots.push_back(ReceiverSlot());
+                receiver_slots[i].receiver = receiver;
+                receiver->setSlot((uint16_t)i, receiver_slots[i].generation);
+                receivers.insert(std::make_pair(s, receiver));
+                return receiver;
+            }
+
+            // nullptr if the receiver of the handle was removed
+            ReceiverRef getReceiverRef(const SubscribeHandle& handle) {
+                if (handle.getSlot() >= receiver_slots.size()) return nullptr;
+                const ReceiverSlot& sl = receiver_slots[handle.getSlot()];
+                return (sl.generation == handle.getGeneration()) ? sl.receiver : nullptr;
+            }
+
+#ifdef MSGPACKETIZER_ENABLE_MEMORY_STATS
+            // add live bytes of unpackers and receivers to the footprint
+            void footprint(memory::Footprint& fp) {
+                using namespace memory;
+                fp.unpacker.add(sizeof(UnpackerManager) + (decoder ? sizeof(MsgPack::Unpacker) + REF_OVERHEAD : 0));
+                fp.unpacker.add(map_bytes(decoders) + map_bytes(receivers) + vector_bytes(receiver_slots));
+                for (auto& d : decoders)
+                    fp.streams[d.first.stream].unpacker.add(sizeof(MsgPack::Unpacker) + REF_OVERHEAD);
+                for (auto& r : receivers) r.second->footprint(fp.streams[r.first.stream]);
+            }
+#endif
+
+            void removeReceiver(const DecodeTargetStream& s) {
+                auto it = receivers.find(s);
+                if (it == receivers.end()) return;
+                for (auto& sl : receiver_slots) {
+                    if (sl.receiver != it->second) continue;
+                    sl.receiver.reset();
+                    if (++sl.generation == 0) sl.generation = 1;
+                }
+                receivers.erase(it);
+            }
+
+            // read streams which are not read by Packetizer
+            // and dispatch packets which are decoded outside of Packetizer::parse()
+            void parse(bool b_exec_cb = true) {
+                (void)b_exec_cb;
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+                // only posix streams are read here
+                uint8_t buffer[MSGPACKETIZER_READ_BUFFER_SIZE];
+                for (auto& r : receivers) {
+                    Receiver* receiver = r.second.get();
+                    if (receiver->getReaderType() != ReaderType::PARSE) continue;
+                    for (size_t i = 0; i < MSGPACKETIZER_MAX_READS_PER_PARSE;) {
+                        const size_t n = receiver->read(
+                            buffer,
+                            sizeof(buffer),
+                            [receiver, b_exec_cb](const uint8_t index, const uint8_t* data, const size_t size) {
+                                if (b_exec_cb) receiver->dispatch(index, data, size);
+                            });
+                        if (!n) break;
+                        // a received UDP batch is bounded, drain it so that fragments are not left half read
+                        if (!receiver->buffered()) ++i;
+                    }
+                }
+#endif
+#ifdef MSGPACKETIZER_ENABLE_THREAD
+                if (b_exec_cb)
+                    for (auto& r : receivers) r.second->deliver();
+#endif
+#ifdef MSGPACKETIZER_ENABLE_MEMORY_STATS
+                memory::Registry::getInstance().sample(memory::Side::SUBSCRIBER, [this](memory::Footprint& fp) {
+                    footprint(fp);
+                });
+#endif
+            }
+
             DecodeTargetStream getDecodeTargetStream(const StreamType& stream) {
                 DecodeTargetStream s;
                 s.stream = (StreamType*)&stream;
@@ -121,60 +714,112 @@ namespace msgpack {
             }
 
 #endif  // MSGPACKETIZER_ENABLE_NETWORK
+
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+            DecodeTargetStream getDecodeTargetStream(const posix::Stream& stream) {
+                DecodeTargetStream s;
+                s.stream = (StreamType*)&stream;
+                s.type = TargetStreamType::STREAM_FD;
+                return s;
+            }
+#endif  // MSGPACKETIZER_ENABLE_POSIX
+#ifdef MSGPACKETIZER_ENABLE_SHM
+            DecodeTargetStream getDecodeTargetStream(const posix::SharedMemory& stream) {
+                DecodeTargetStream s;
+                s.stream = (StreamType*)&stream;
+                s.type = TargetStreamType::STREAM_SHM;
+                return s;
+            }
+#endif  // MSGPACKETIZER_ENABLE_SHM
 #endif  // MSGPACKETIZER_ENABLE_STREAM
         };
 
 #ifdef ARDUINOJSON_VERSION
 
         namespace detail {
-            template <size_t N>
-            inline void subscribe_staticjson(
-                const uint8_t* data, const std::function<void(const StaticJsonDocument<N>&)>& callback) {
-                StaticJsonDocument<N> doc;
-                auto err = deserializeMsgPack(doc, data);
+            inline bool deserialize_json(JsonDocument& doc, const uint8_t* data, const size_t size) {
+                auto err = deserializeMsgPack(doc, data, size);
+                if (err) {
+                    LOG_ERROR(F("deserializeJson() faled: "), err.c_str());
+                    return false;
+                }
+                return true;
+            }
+            template <typename Filter>
+            inline bool deserialize_json(
+                JsonDocument& doc, const uint8_t* data, const size_t size, const Filter& filter) {
+                auto err = deserializeMsgPack(doc, data, size, DeserializationOption::Filter(filter));
                 if (err) {
                     LOG_ERROR(F("deserializeJson() faled: "), err.c_str());
-                } else {
-                    callback(doc);
+                    return false;
                 }
+                return true;
+            }
+
+            template <size_t N>
+            inline void subscribe_staticjson(
+                const uint8_t* data,
+                const size_t size,
+                Pool<StaticJsonDocument<N>>& pool,
+                const std::function<void(const StaticJsonDocument<N>&)>& callback) {
+                pool.use([&](StaticJsonDocument<N>& doc) {
+                    if (deserialize_json(doc, data, size)) callback(doc);
+                });
             }
             inline void deserialize_dynamicjson(
                 const uint8_t* data,
                 const size_t size,
+                DynamicJsonDocumentPool<>& pool,
                 const std::function<void(const DynamicJsonDocument&)>& callback) {
-                DynamicJsonDocument doc(size * MSGPACKETIZER_ARDUINOJSON_DESERIALIZE_BUFFER_SCALE);
-                auto err = deserializeMsgPack(doc, data);
-                if (err) {
-                    LOG_ERROR(F("deserializeJson() faled: "), err.c_str());
-                } else {
-                    callback(doc);
-                }
+                pool.use(size * MSGPACKETIZER_ARDUINOJSON_DESERIALIZE_BUFFER_SCALE, [&](DynamicJsonDocument& doc) {
+                    if (deserialize_json(doc, data, size)) callback(doc);
+                });
             }
             template <size_t N>
             inline void subscribe_staticjson_index(
                 const uint8_t index,
                 const uint8_t* data,
+                const size_t size,
+                Pool<StaticJsonDocument<N>>& pool,
                 const std::function<void(uint8_t, const StaticJsonDocument<N>&)>& callback) {
-                StaticJsonDocument<N> doc;
-                auto err = deserializeMsgPack(doc, data);
-                if (err) {
-                    LOG_ERROR(F("deserializeJson() faled: "), err.c_str());
-                } else {
-                    callback(index, doc);
-                }
+                pool.use([&](StaticJsonDocument<N>& doc) {
+                    if (deserialize_json(doc, data, size)) callback(index, doc);
+                });
             }
             inline void deserialize_dynamicjson_index(
                 const uint8_t index,
                 const uint8_t* data,
                 const size_t size,
+                DynamicJsonDocumentPool<>& pool,
                 const std::function<void(uint8_t, const DynamicJsonDocument&)>& callback) {
-                DynamicJsonDocument doc(size * MSGPACKETIZER_ARDUINOJSON_DESERIALIZE_BUFFER_SCALE);
-                auto err = deserializeMsgPack(doc, data);
-                if (err) {
-                    LOG_ERROR(F("deserializeJson() faled: "), err.c_str());
-                } else {
-                    callback(index, doc);
-                }
+                pool.use(size * MSGPACKETIZER_ARDUINOJSON_DESERIALIZE_BUFFER_SCALE, [&](DynamicJsonDocument& doc) {
+                    if (deserialize_json(doc, data, size)) callback(index, doc);
+                });
+            }
+
+            // documents are pooled as other subscriptions (see MSGPACKETIZER_DECODE_POOL_SIZE)
+            // and only fields in the filter are decoded
+            template <size_t N, typename Filter>
+            inline Packetizer::CallbackType make_json_callback(
+                const Filter& filter, std::function<void(const StaticJsonDocument<N>&)>&& callback) {
+                auto doc = std::make_shared<Pool<StaticJsonDocument<N>>>();
+                auto f = std::make_shared<Filter>(filter);
+                return [doc, f, callback](const uint8_t* data, const size_t size) {
+                    doc->use([&](StaticJsonDocument<N>& d) {
+                        if (deserialize_json(d, data, size, *f)) callback(d);
+                    });
+                };
+            }
+            template <typename Filter>
+            inline Packetizer::CallbackType make_json_callback(
+                const Filter& filter, std::function<void(const DynamicJsonDocument&)>&& callback) {
+                auto doc = std::make_shared<DynamicJsonDocumentPool<>>();
+                auto f = std::make_shared<Filter>(filter);
+                return [doc, f, callback](const uint8_t* data, const size_t size) {
+                    doc->use(size * MSGPACKETIZER_ARDUINOJSON_DESERIALIZE_BUFFER_SCALE, [&](DynamicJsonDocument& d) {
+                        if (deserialize_json(d, data, size, *f)) callback(d);
+                    });
+                };
             }
         }  // namespace detail
 
@@ -224,13 +869,16 @@ namespace msgpack {
         namespace detail {
             template <typename R, typename... Args>
             inline void subscribe_manual(const uint8_t index, std::function<R(Args...)>&& callback) {
-                Packetizer::subscribe(index, [&, callback](const uint8_t* data, const size_t size) {
+                using Tuple = std::tuple<std::remove_cvref_t<Args>...>;
+                auto pool = std::make_shared<Pool<Tuple>>();
+                Packetizer::subscribe(index, [&, pool, callback](const uint8_t* data, const size_t size) {
                     auto unpacker = UnpackerManager::getInstance().getUnpackerRef();
                     unpacker->clear();
                     unpacker->feed(data, size);
-                    std::tuple<std::remove_cvref_t<Args>...> t;
-                    unpacker->to_tuple(t);
-                    std::apply(callback, t);
+                    pool->use([&](Tuple& t) {
+                        // drop packets which cannot be decoded into arguments of the callback
+                        if (unpacker->to_tuple(t)) std::apply(callback, t);
+                    });
                 });
             }
 
@@ -249,25 +897,30 @@ namespace msgpack {
             template <size_t N>
             inline void subscribe_manual(
                 const uint8_t index, std::function<void(const StaticJsonDocument<N>&)>&& callback) {
-                Packetizer::subscribe(
-                    index, [&, callback](const uint8_t* data, const size_t) { subscribe_staticjson(data, callback); });
+                auto pool = std::make_shared<Pool<StaticJsonDocument<N>>>();
+                Packetizer::subscribe(index, [&, pool, callback](const uint8_t* data, const size_t size) {
+                    subscribe_staticjson(data, size, *pool, callback);
+                });
             }
             inline void subscribe_manual(
                 const uint8_t index, std::function<void(const DynamicJsonDocument&)>&& callback) {
-                Packetizer::subscribe(index, [&, callback](const uint8_t* data, const size_t size) {
-                    deserialize_dynamicjson(data, size, callback);
+                auto pool = std::make_shared<DynamicJsonDocumentPool<>>();
+                Packetizer::subscribe(index, [&, pool, callback](const uint8_t* data, const size_t size) {
+                    deserialize_dynamicjson(data, size, *pool, callback);
                 });
             }
 
             template <size_t N>
             inline void subscribe_manual(std::function<void(const uint8_t, const StaticJsonDocument<N>&)>&& callback) {
-                Packetizer::subscribe([&, callback](const uint8_t index, const uint8_t* data, const size_t) {
-                    subscribe_staticjson_index(index, data, callback);
+                auto pool = std::make_shared<Pool<StaticJsonDocument<N>>>();
+                Packetizer::subscribe([&, pool, callback](const uint8_t index, const uint8_t* data, const size_t size) {
+                    subscribe_staticjson_index(index, data, size, *pool, callback);
                 });
             }
             inline void subscribe_manual(std::function<void(const uint8_t, const DynamicJsonDocument&)>&& callback) {
-                Packetizer::subscribe([&, callback](const uint8_t index, const uint8_t* data, const size_t size) {
-                    deserialize_dynamicjson_index(index, data, size, callback);
+                auto pool = std::make_shared<DynamicJsonDocumentPool<>>();
+                Packetizer::subscribe([&, pool, callback](const uint8_t index, const uint8_t* data, const size_t size) {
+                    deserialize_dynamicjson_index(index, data, size, *pool, callback);
                 });
             }
 
@@ -288,6 +941,18 @@ namespace msgpack {
             detail::subscribe_manual(arx::function_traits<F>::cast(std::move(callback)));
         }
 
+#ifdef ARDUINOJSON_VERSION
+
+        // bind json callback which decodes only the fields in filter to specified index packet
+        template <typename Filter, typename F>
+        inline auto subscribe_manual_json(const uint8_t index, const Filter& filter, F&& callback)
+            -> std::enable_if_t<arx::is_callable<F>::value> {
+            Packetizer::subscribe(
+                index, detail::make_json_callback(filter, arx::function_traits<F>::cast(std::move(callback))));
+        }
+
+#endif  // ARDUINOJSON_VERSION
+
         // unsubscribe
         inline void unsubscribe_manual(const uint8_t index) {
             Packetizer::unsubscribe(index);
@@ -295,6 +960,7 @@ namespace msgpack {
 
         // feed packet manually: must be called to manual decoding
         inline void feed(const uint8_t* data, const size_t size) {
+            trace::Scope scope(trace::PARSE, 0);
             Packetizer::feed(data, size);
         }
 
@@ -302,97 +968,164 @@ namespace msgpack {
 
         // ----- for supported communication interface (Arduino, oF, ROS) -----
 
+        namespace detail {
+#ifdef MSGPACKETIZER_ENABLE_PACKETIZER_STREAM
+
+            // get Receiver of the stream, Packetizer forwards packets to it if the stream is read by Packetizer
+            template <typename S>
+            inline auto getReceiverRef(S& stream) -> std::enable_if_t<!is_posix_stream<S>::value, ReceiverRef> {
+                auto& manager = UnpackerManager::getInstance();
+                const DecodeTargetStream target = manager.getDecodeTargetStream(stream);
+                if (manager.hasReceiver(target)) return manager.getReceiverRef(target);
+
+                ReceiverRef receiver = manager.getReceiverRef(target);
+                Packetizer::subscribe(stream, [receiver](const uint8_t index, const uint8_t* data, const size_t size) {
+                    receiver->dispatch(index, data, size);
+                });
+                return receiver;
+            }
+
+            // stop Packetizer from reading the stream
+            template <typename S>
+            inline auto unsubscribe_packetizer(const S& stream) -> std::enable_if_t<!is_posix_stream<S>::value> {
+                Packetizer::unsubscribe(stream);
+            }
+
+#endif  // MSGPACKETIZER_ENABLE_PACKETIZER_STREAM
+#ifdef MSGPACKETIZER_ENABLE_POSIX
+
+            // posix streams are read in parse() because Packetizer does not know them
+            template <typename S>
+            inline auto getReceiverRef(S& stream) -> std::enable_if_t<is_posix_stream<S>::value, ReceiverRef> {
+                auto& manager = UnpackerManager::getInstance();
+                const DecodeTargetStream target = manager.getDecodeTargetStream(stream);
+                const bool b_exists = manager.hasReceiver(target);
+                ReceiverRef receiver = manager.getReceiverRef(target);
+                if (!b_exists) receiver->setReaderType(ReaderType::PARSE);
+                return receiver;
+            }
+
+            template <typename S>
+            inline auto unsubscribe_packetizer(const S&) -> std::enable_if_t<is_posix_stream<S>::value> {}
+
+#endif  // MSGPACKETIZER_ENABLE_POSIX
+        }  // namespace detail
+
         template <typename S, typename... Args>
-        inline void subscribe(S& stream, const uint8_t index, Args&&... args) {
-            Packetizer::subscribe(stream, index, [&](const uint8_t* data, const size_t size) {
-                auto unpacker = UnpackerManager::getInstance().getUnpackerRef(stream);
+        inline SubscribeHandle subscribe(S& stream, const uint8_t index, Args&&... args) {
+            auto unpacker = UnpackerManager::getInstance().getUnpackerRef(stream);
+            ReceiverRef receiver = detail::getReceiverRef(stream);
+            receiver->subscribe(index, [&, unpacker](const uint8_t* data, const size_t size) {
                 unpacker->clear();
                 unpacker->feed(data, size);
                 unpacker->deserialize(std::forward<Args>(args)...);
             });
+            return receiver->handle(index);
         }
 
         template <typename S, typename... Args>
-        inline void subscribe_arr(S& stream, const uint8_t index, Args&&... args) {
-            static MsgPack::arr_size_t sz;
-            Packetizer::subscribe(stream, index, [&](const uint8_t* data, const size_t size) {
-                auto unpacker = UnpackerManager::getInstance().getUnpackerRef(stream);
+        inline SubscribeHandle subscribe_arr(S& stream, const uint8_t index, Args&&... args) {
+            auto unpacker = UnpackerManager::getInstance().getUnpackerRef(stream);
+            ReceiverRef receiver = detail::getReceiverRef(stream);
+            receiver->subscribe(index, [&, unpacker](const uint8_t* data, const size_t size) {
+                MsgPack::arr_size_t sz;
                 unpacker->clear();
                 unpacker->feed(data, size);
                 unpacker->deserialize(sz, std::forward<Args>(args)...);
             });
+            return receiver->handle(index);
         }
 
         template <typename S, typename... Args>
-        inline void subscribe_map(S& stream, const uint8_t index, Args&&... args) {
+        inline SubscribeHandle subscribe_map(S& stream, const uint8_t index, Args&&... args) {
             if ((sizeof...(args) % 2) == 0) {
-                static MsgPack::map_size_t sz;
-                Packetizer::subscribe(stream, index, [&](const uint8_t* data, const size_t size) {
-                    auto unpacker = UnpackerManager::getInstance().getUnpackerRef(stream);
+                auto unpacker = UnpackerManager::getInstance().getUnpackerRef(stream);
+                ReceiverRef receiver = detail::getReceiverRef(stream);
+                receiver->subscribe(index, [&, unpacker](const uint8_t* data, const size_t size) {
+                    MsgPack::map_size_t sz;
                     unpacker->clear();
                     unpacker->feed(data, size);
                     unpacker->deserialize(sz, std::forward<Args>(args)...);
                 });
+                return receiver->handle(index);
             } else {
                 LOG_WARN(F("deserialize arg size must be even for map :"), sizeof...(args));
+                return SubscribeHandle();
             }
         }
 
         namespace detail {
             template <typename S, typename R, typename... Args>
-            inline void subscribe(S& stream, const uint8_t index, std::function<R(Args...)>&& callback) {
-                Packetizer::subscribe(stream, index, [&, callback](const uint8_t* data, const size_t size) {
-                    auto unpacker = UnpackerManager::getInstance().getUnpackerRef(stream);
+            inline SubscribeHandle subscribe(S& stream, const uint8_t index, std::function<R(Args...)>&& callback) {
+                using Tuple = std::tuple<std::remove_cvref_t<Args>...>;
+                auto unpacker = UnpackerManager::getInstance().getUnpackerRef(stream);
+                auto pool = std::make_shared<Pool<Tuple>>();
+                ReceiverRef receiver = getReceiverRef(stream);
+                receiver->subscribe(index, [unpacker, pool, callback](const uint8_t* data, const size_t size) {
                     unpacker->clear();
                     unpacker->feed(data, size);
-                    std::tuple<std::remove_cvref_t<Args>...> t;
-                    unpacker->to_tuple(t);
-                    std::apply(callback, t);
+                    pool->use([&](Tuple& t) {
+                        // drop packets which cannot be decoded into arguments of the callback
+                        if (unpacker->to_tuple(t)) std::apply(callback, t);
+                    });
                 });
+                return receiver->handle(index);
             }
 
             template <typename S, typename R, typename... Args>
-            inline void subscribe(S& stream, std::function<R(Args...)>&& callback) {
-                Packetizer::subscribe(
-                    stream, [&, callback](const uint8_t index, const uint8_t* data, const size_t size) {
-                        auto unpacker = UnpackerManager::getInstance().getUnpackerRef(stream);
-                        unpacker->clear();
-                        unpacker->feed(data, size);
-                        callback(index, *unpacker);
-                    });
+            inline SubscribeHandle subscribe(S& stream, std::function<R(Args...)>&& callback) {
+                auto unpacker = UnpackerManager::getInstance().getUnpackerRef(stream);
+                ReceiverRef receiver = getReceiverRef(stream);
+                receiver->subscribe([unpacker, callback](const uint8_t index, const uint8_t* data, const size_t size) {
+                    unpacker->clear();
+                    unpacker->feed(data, size);
+                    callback(index, *unpacker);
+                });
+                return receiver->handle();
             }
 
 #ifdef ARDUINOJSON_VERSION
 
             template <typename S, size_t N>
-            inline void subscribe(
+            inline SubscribeHandle subscribe(
                 S& stream, const uint8_t index, std::function<void(const StaticJsonDocument<N>&)>&& callback) {
-                Packetizer::subscribe(stream, index, [&, callback](const uint8_t* data, const size_t) {
-                    subscribe_staticjson(data, callback);
+                auto pool = std::make_shared<Pool<StaticJsonDocument<N>>>();
+                ReceiverRef receiver = getReceiverRef(stream);
+                receiver->subscribe(index, [pool, callback](const uint8_t* data, const size_t size) {
+                    subscribe_staticjson(data, size, *pool, callback);
                 });
+                return receiver->handle(index);
             }
             template <typename S>
-            inline void subscribe(
+            inline SubscribeHandle subscribe(
                 S& stream, const uint8_t index, std::function<void(const DynamicJsonDocument&)>&& callback) {
-                Packetizer::subscribe(stream, index, [&, callback](const uint8_t* data, const size_t size) {
-                    deserialize_dynamicjson(data, size, callback);
+                auto pool = std::make_shared<DynamicJsonDocumentPool<>>();
+                ReceiverRef receiver = getReceiverRef(stream);
+                receiver->subscribe(index, [pool, callback](const uint8_t* data, const size_t size) {
+                    deserialize_dynamicjson(data, size, *pool, callback);
                 });
+                return receiver->handle(index);
             }
 
             template <typename S, size_t N>
-            inline void subscribe(
+            inline SubscribeHandle subscribe(
                 S& stream, std::function<void(const uint8_t, const StaticJsonDocument<N>&)>&& callback) {
-                Packetizer::subscribe(stream, [&, callback](const uint8_t index, const uint8_t* data, const size_t) {
-                    subscribe_staticjson_index(index, data, callback);
+                auto pool = std::make_shared<Pool<StaticJsonDocument<N>>>();
+                ReceiverRef receiver = getReceiverRef(stream);
+                receiver->subscribe([pool, callback](const uint8_t index, const uint8_t* data, const size_t size) {
+                    subscribe_staticjson_index(index, data, size, *pool, callback);
                 });
+                return receiver->handle();
             }
             template <typename S>
-            inline void subscribe(
+            inline SubscribeHandle subscribe(
                 S& stream, std::function<void(const uint8_t, const DynamicJsonDocument&)>&& callback) {
-                Packetizer::subscribe(
-                    stream, [&, callback](const uint8_t index, const uint8_t* data, const size_t size) {
-                        deserialize_dynamicjson_index(index, data, size, callback);
-                    });
+                auto pool = std::make_shared<DynamicJsonDocumentPool<>>();
+                ReceiverRef receiver = getReceiverRef(stream);
+                receiver->subscribe([pool, callback](const uint8_t index, const uint8_t* data, const size_t size) {
+                    deserialize_dynamicjson_index(index, data, size, *pool, callback);
+                });
+                return receiver->handle();
             }
 
 #endif  // ARDUINOJSON_VERSION
@@ -401,23 +1134,96 @@ namespace msgpack {
 
         template <typename S, typename F>
         inline auto subscribe(S& stream, const uint8_t index, F&& callback)
-            -> std::enable_if_t<arx::is_callable<F>::value> {
-            detail::subscribe(stream, index, arx::function_traits<F>::cast(std::move(callback)));
+            -> std::enable_if_t<arx::is_callable<F>::value, SubscribeHandle> {
+            return detail::subscribe(stream, index, arx::function_traits<F>::cast(std::move(callback)));
         }
 
         template <typename S, typename F>
-        inline auto subscribe(S& stream, F&& callback) -> std::enable_if_t<arx::is_callable<F>::value> {
-            detail::subscribe(stream, arx::function_traits<F>::cast(std::move(callback)));
+        inline auto subscribe(S& stream, F&& callback)
+            -> std::enable_if_t<arx::is_callable<F>::value, SubscribeHandle> {
+            return detail::subscribe(stream, arx::function_traits<F>::cast(std::move(callback)));
         }
 
+#ifdef ARDUINOJSON_VERSION
+
+        template <typename S, typename Filter, typename F>
+        inline auto subscribe_json(S& stream, const uint8_t index, const Filter& filter, F&& callback)
+            -> std::enable_if_t<arx::is_callable<F>::value, SubscribeHandle> {
+            ReceiverRef receiver = detail::getReceiverRef(stream);
+            receiver->subscribe(
+                index, detail::make_json_callback(filter, arx::function_traits<F>::cast(std::move(callback))));
+            return receiver->handle(index);
+        }
+
+#endif  // ARDUINOJSON_VERSION
+
         template <typename S>
         inline void unsubscribe(const S& stream, const uint8_t index) {
-            Packetizer::unsubscribe(stream, index);
+            auto& manager = UnpackerManager::getInstance();
+            const DecodeTargetStream target = manager.getDecodeTargetStream(stream);
+            if (manager.hasReceiver(target)) manager.getReceiverRef(target)->unsubscribe(index);
         }
 
         template <typename S>
         inline void unsubscribe(const S& stream) {
-            Packetizer::unsubscribe(stream);
+            auto& manager = UnpackerManager::getInstance();
+            const DecodeTargetStream target = manager.getDecodeTargetStream(stream);
+            if (!manager.hasReceiver(target)) return;
+            ReceiverRef receiver = manager.getReceiverRef(target);
+            receiver->unsubscribe();
+            if (receiver->getReaderType() == ReaderType::PACKETIZER) {
+                detail::unsubscribe_packetizer(stream);
+                manager.removeReceiver(target);
+            }
+        }
+
+        // remove the subscriber of the handle (the index or all indices subscribed without index)
+        inline void unsubscribe(const SubscribeHandle& handle) {
+            ReceiverRef receiver = UnpackerManager::getInstance().getReceiverRef(handle);
+            if (!receiver) return;
+            if (handle.isAll())
+                receiver->unsubscribeAlways();
+            else
+                receiver->unsubscribe(handle.getIndex());
+        }
+
+#if defined(MSGPACKETIZER_ENABLE_NETWORK) && defined(MSGPACKETIZER_ENABLE_RELIABLE)
+
+        // deliver messages of the index to the peer and from the peer reliably (call it on both peers)
+        // the socket is read by parse() to receive acks even if nothing is subscribed from it
+        inline void setReliable(UDP& stream, const str_t& ip, const uint16_t port, const uint8_t index) {
+            detail::getReceiverRef(stream);
+            reliable::Registry::getInstance().open(&stream, index, ip, Destination::resolve(ip), port);
+        }
+
+        inline void removeReliable(const UDP& stream, const uint8_t index) {
+            reliable::Registry::getInstance().close(&stream, index);
+        }
+
+#endif  // MSGPACKETIZER_ENABLE_NETWORK && MSGPACKETIZER_ENABLE_RELIABLE
+
+#ifdef MSGPACKETIZER_ENABLE_NETWORK
+
+        // latency of messages received from one peer of the UDP socket
+        inline latency::Distribution getLatency(
+            const UDP& stream, const str_t& ip, const uint16_t port, const uint8_t index) {
+            return latency::Registry::getInstance().distribution(
+                &stream, latency::peer(Destination::resolve(ip), port), index);
+        }
+
+        // clock offset of one peer of the UDP socket
+        inline latency::ClockOffset getClockOffset(const UDP& stream, const str_t& ip, const uint16_t port) {
+            return latency::Registry::getInstance().offset(&stream, latency::peer(Destination::resolve(ip), port));
+        }
+
+#endif  // MSGPACKETIZER_ENABLE_NETWORK
+
+        // number of fragmented messages from the stream which could not be reassembled
+        template <typename S>
+        inline uint32_t getFragmentsDropped(const S& stream) {
+            auto& manager = UnpackerManager::getInstance();
+            const DecodeTargetStream target = manager.getDecodeTargetStream(stream);
+            return manager.hasReceiver(target) ? manager.getReceiverRef(target)->fragmentsDropped() : 0;
         }
 
         template <typename S>
@@ -430,14 +1236,45 @@ namespace msgpack {
         }
 
         inline void parse(bool b_exec_cb = true) {
+            trace::Scope scope(trace::PARSE, 0);
+#ifdef MSGPACKETIZER_ENABLE_PACKETIZER_STREAM
             Packetizer::parse(b_exec_cb);
+#endif
+            UnpackerManager::getInstance().parse(b_exec_cb);
         }
 
         inline void update(bool b_exec_cb = true) {
-            Packetizer::parse(b_exec_cb);
+            parse(b_exec_cb);
             PackerManager::getInstance().post();
         }
 
+#ifdef MSGPACKETIZER_ENABLE_MEMORY_STATS
+
+        // live and peak bytes used by publishers and subscribers of all streams
+        inline memory::Footprint getMemoryFootprint() {
+            auto& registry = memory::Registry::getInstance();
+            registry.sample(memory::Side::PUBLISHER, [](memory::Footprint& fp) {
+                PackerManager::getInstance().footprint(fp);
+            });
+            registry.sample(memory::Side::SUBSCRIBER, [](memory::Footprint& fp) {
+                UnpackerManager::getInstance().footprint(fp);
+            });
+            return registry.get();
+        }
+
+        template <typename S>
+        inline memory::StreamFootprint getMemoryFootprint(const S& stream) {
+            const memory::Footprint fp = getMemoryFootprint();
+            auto it = fp.streams.find((const void*)&stream);
+            return (it == fp.streams.end()) ? memory::StreamFootprint() : it->second;
+        }
+
+        inline void resetMemoryFootprint() {
+            memory::Registry::getInstance().reset();
+        }
+
+#endif  // MSGPACKETIZER_ENABLE_MEMORY_STATS
+
 #endif  // MSGPACKETIZER_ENABLE_STREAM
 
     }  // namespace msgpacketizer
@@ -0,0 +1,172 @@
+#pragma once
+
+#ifndef HT_SERIAL_MSGPACKETIZER_TRACE_H
+#define HT_SERIAL_MSGPACKETIZER_TRACE_H
+
+// capacity of events in trace::ChromeTrace (must be power of two)
+#ifndef MSGPACKETIZER_TRACE_CAPACITY
+#define MSGPACKETIZER_TRACE_CAPACITY 65536
+#endif
+
+namespace arduino {
+namespace msgpack {
+    namespace msgpacketizer {
+
+        // Begin / end events of hot paths are sent to the sink selected by MSGPACKETIZER_TRACE_SINK.
+        // A sink is a type with `static void begin(const char* event, uint8_t index)` and `end()` of the same
+        // signature. Without the macro, every trace::Scope is an empty object and compiled to nothing.
+        namespace trace {
+
+            // event names passed to sinks
+            static constexpr const char* POST {"post"};              // PackerManager::post()
+            static constexpr const char* ENCODE {"encode"};          // msgpack encoding of published element
+            static constexpr const char* FRAME {"frame"};            // COBS + CRC encoding (posix streams)
+            static constexpr const char* WRITE {"write"};            // write to stream (frame + write for Packetizer)
+            static constexpr const char* PARSE {"parse"};            // parse() and feed()
+            static constexpr const char* READ {"read"};              // read from stream (not read by Packetizer)
+            static constexpr const char* DISPATCH {"dispatch"};      // taps, reassembly and subscribers of a frame
+            static constexpr const char* SUBSCRIBER {"subscriber"};  // msgpack decoding and subscriber callback
+
+            struct NullSink {
+                static void begin(const char*, const uint8_t) {}
+                static void end(const char*, const uint8_t) {}
+            };
+
+            template <typename S>
+            class BasicScope {
+                const char* event;
+                uint8_t index;
+
+            public:
+                BasicScope(const char* event, const uint8_t index) : event(event), index(index) {
+                    S::begin(event, index);
+                }
+                ~BasicScope() {
+                    S::end(event, index);
+                }
+            };
+
+            template <>
+            class BasicScope<NullSink> {
+            public:
+                BasicScope(const char*, const uint8_t) {}
+            };
+
+#if defined(MSGPACKETIZER_TRACE_SINK) && !defined(ARDUINO)
+
+            // Lock-free ring of events exported as Chrome trace JSON (chrome://tracing, Perfetto).
+            // Every event is stored in atomic words validated by its sequence number,
+            // so write() can be called while other threads are tracing.
+            class ChromeTrace {
+                static constexpr size_t CAPACITY {MSGPACKETIZER_TRACE_CAPACITY};
+                static_assert((CAPACITY & (CAPACITY - 1)) == 0, "MSGPACKETIZER_TRACE_CAPACITY must be power of two");
+
+                struct Record {
+                    std::atomic<uint64_t> seq {0};  // position + 1 after the record is written
+                    std::atomic<uint64_t> ts_ns {0};
+                    std::atomic<uintptr_t> event {0};
+                    std::atomic<uint64_t> info {0};  // tid << 16 | index << 8 | phase
+                };
+
+                static Record* records() {
+                    static Record r[CAPACITY];
+                    return r;
+                }
+
+                static std::atomic<uint64_t>& head() {
+                    static std::atomic<uint64_t> h {0};
+                    return h;
+                }
+
+                static std::chrono::steady_clock::time_point origin() {
+                    static const std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+                    return t;
+                }
+
+                static uint32_t tid() {
+                    thread_local const uint32_t id =
+                        (uint32_t)std::hash<std::thread::id> {}(std::this_thread::get_id());
+                    return id;
+                }
+
+                static void push(const char phase, const char* event, const uint8_t index) {
+                    const uint64_t ts = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                            std::chrono::steady_clock::now() - origin())
+                                            .count();
+                    const uint64_t pos = head().fetch_add(1, std::memory_order_relaxed);
+                    Record& r = records()[pos & (CAPACITY - 1)];
+                    r.seq.store(0, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_release);
+                    r.ts_ns.store(ts, std::memory_order_relaxed);
+                    r.event.store((uintptr_t)event, std::memory_order_relaxed);
+                    const uint64_t info = ((uint64_t)tid() << 16) | ((uint64_t)index << 8) | (uint8_t)phase;
+                    r.info.store(info, std::memory_order_relaxed);
+                    r.seq.store(pos + 1, std::memory_order_release);
+                }
+
+            public:
+                static void begin(const char* event, const uint8_t index) {
+                    push('B', event, index);
+                }
+
+                static void end(const char* event, const uint8_t index) {
+                    push('E', event, index);
+                }
+
+                // drop all recorded events
+                static void clear() {
+                    for (size_t i = 0; i < CAPACITY; ++i) records()[i].seq.store(0, std::memory_order_relaxed);
+                }
+
+                // write the last MSGPACKETIZER_TRACE_CAPACITY events as {"traceEvents": [...]}
+                static bool write(const char* path) {
+                    FILE* fp = std::fopen(path, "w");
+                    if (!fp) {
+                        LOG_ERROR(F("cannot open trace file: "), path);
+                        return false;
+                    }
+                    const uint64_t end = head().load(std::memory_order_acquire);
+                    const uint64_t begin = (end > CAPACITY) ? end - CAPACITY : 0;
+                    std::fprintf(fp, "{\"traceEvents\":[\n");
+                    bool b_first = true;
+                    for (uint64_t pos = begin; pos < end; ++pos) {
+                        const Record& r = records()[pos & (CAPACITY - 1)];
+                        if (r.seq.load(std::memory_order_acquire) != pos + 1) continue;
+                        const uint64_t ts = r.ts_ns.load(std::memory_order_relaxed);
+                        const char* event = (const char*)r.event.load(std::memory_order_relaxed);
+                        const uint64_t info = r.info.load(std::memory_order_relaxed);
+                        std::atomic_thread_fence(std::memory_order_acquire);
+                        if (r.seq.load(std::memory_order_relaxed) != pos + 1) continue;  // overwritten while reading
+                        std::fprintf(
+                            fp,
+                            "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,"
+                            "\"pid\":1,\"tid\":%u,\"args\":{\"index\":%u}}",
+                            b_first ? "" : ",\n",
+                            event,
+                            (char)(info & 0xFF),
+                            (double)ts / 1000.,
+                            (uint32_t)(info >> 16),
+                            (uint32_t)((info >> 8) & 0xFF));
+                        b_first = false;
+                    }
+                    std::fprintf(fp, "\n]}\n");
+                    return std::fclose(fp) == 0;
+                }
+            };
+
+#endif  // MSGPACKETIZER_TRACE_SINK && !ARDUINO
+
+#ifdef MSGPACKETIZER_TRACE_SINK
+            using Sink = MSGPACKETIZER_TRACE_SINK;
+#else
+            using Sink = NullSink;
+#endif
+            using Scope = BasicScope<Sink>;
+
+        }  // namespace trace
+
+    }  // namespace msgpacketizer
+}  // namespace msgpack
+}  // namespace arduino
+
+#endif  // HT_SERIAL_MSGPACKETIZER_TRACE_H
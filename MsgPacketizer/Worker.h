@@ -0,0 +1,175 @@
+#pragma once
+
+#ifndef HT_SERIAL_MSGPACKETIZER_WORKER_H
+#define HT_SERIAL_MSGPACKETIZER_WORKER_H
+
+#if defined(MSGPACKETIZER_ENABLE_STREAM) && defined(MSGPACKETIZER_ENABLE_THREAD)
+
+#ifndef MSGPACKETIZER_WORKER_BUFFER_SIZE
+#define MSGPACKETIZER_WORKER_BUFFER_SIZE 1024
+#endif
+#ifndef MSGPACKETIZER_WORKER_IDLE_USEC
+#define MSGPACKETIZER_WORKER_IDLE_USEC 100
+#endif
+
+namespace arduino {
+namespace msgpack {
+    namespace msgpacketizer {
+
+        // where callbacks of streams attached to Worker are called
+        enum class Delivery : uint8_t {
+            WORKER,     // on the worker thread, right after decoding
+            MAIN_LOOP,  // in parse() / update(), in received order per stream
+        };
+
+        // reads, decodes and dispatches packets of attached streams on its own thread
+        class Worker {
+            Delivery delivery;
+            uint32_t idle_us {MSGPACKETIZER_WORKER_IDLE_USEC};
+            std::vector<ReceiverRef> receivers;
+            std::thread th;
+            std::atomic<bool> b_running {false};
+
+        public:
+            explicit Worker(const Delivery delivery = Delivery::WORKER) : delivery(delivery) {}
+            Worker(const Worker&) = delete;
+            Worker& operator=(const Worker&) = delete;
+            ~Worker() {
+                stop();
+            }
+
+            // streams should be attached before subscribe() and while the worker is stopped
+            template <typename S>
+            void attach(S& stream) {
+                if (b_running) {
+                    LOG_WARN(F("stop worker before attaching stream"));
+                    return;
+                }
+                auto& manager = UnpackerManager::getInstance();
+                const DecodeTargetStream target = manager.getDecodeTargetStream(stream);
+                if (manager.hasReceiver(target)
+                    && (manager.getReceiverRef(target)->getReaderType() == ReaderType::PACKETIZER)) {
+                    LOG_WARN(F("stream is already read by Packetizer, attach worker before subscribe"));
+                    detail::unsubscribe_packetizer(stream);
+                }
+                ReceiverRef receiver = manager.getReceiverRef(target);
+                receiver->setReaderType(ReaderType::WORKER);
+                manager.getUnpackerRef(stream);
+                receivers.push_back(receiver);
+            }
+
+            void start() {
+                if (b_running) return;
+                b_running = true;
+                th = std::thread([this] { run(); });
+            }
+
+            void stop() {
+                b_running = false;
+                if (th.joinable()) th.join();
+            }
+
+            bool isRunning() const {
+                return b_running;
+            }
+
+            Delivery getDelivery() const {
+                return delivery;
+            }
+
+            // sleep time when no byte was read from any attached stream
+            void setIdleUsec(const uint32_t us) {
+                idle_us = us;
+            }
+
+        private:
+            void run() {
+                uint8_t buffer[MSGPACKETIZER_WORKER_BUFFER_SIZE];
+                while (b_running) {
+                    size_t n_read = 0;
+                    for (auto& r : receivers) {
+                        Receiver* receiver = r.get();
+                        if (delivery == Delivery::WORKER)
+                            n_read += receiver->read(
+                                buffer,
+                                sizeof(buffer),
+                                [receiver](const uint8_t index, const uint8_t* data, const size_t size) {
+                                    receiver->dispatch(index, data, size);
+                                });
+                        else
+                            n_read += receiver->read(
+                                buffer,
+                                sizeof(buffer),
+                                [receiver](const uint8_t index, const uint8_t* data, const size_t size) {
+                                    receiver->post(index, data, size);
+                                });
+                    }
+                    if (n_read == 0) std::this_thread::sleep_for(std::chrono::microseconds(idle_us));
+                }
+            }
+        };
+
+        using WorkerRef = std::shared_ptr<Worker>;
+
+        class WorkerManager {
+            WorkerManager() {}
+            WorkerManager(const WorkerManager&) = delete;
+            WorkerManager& operator=(const WorkerManager&) = delete;
+
+            std::vector<WorkerRef> workers;
+
+        public:
+            static WorkerManager& getInstance() {
+                static WorkerManager m;
+                return m;
+            }
+
+            const std::vector<WorkerRef>& getWorkers() const {
+                return workers;
+            }
+
+            void add(const WorkerRef& worker) {
+                workers.push_back(worker);
+            }
+
+            void stop() {
+                for (auto& w : workers) w->stop();
+                workers.clear();
+            }
+        };
+
+        namespace detail {
+            template <typename S>
+            inline void attach(Worker& worker, S& stream) {
+                worker.attach(stream);
+            }
+            template <typename S, typename... Ss>
+            inline void attach(Worker& worker, S& stream, Ss&... streams) {
+                worker.attach(stream);
+                attach(worker, streams...);
+            }
+        }  // namespace detail
+
+        // parse streams on a dedicated thread with its own unpacker per stream
+        // must be called before subscribe() to the streams
+        template <typename... Ss>
+        inline WorkerRef make_worker(const Delivery delivery, Ss&... streams) {
+            WorkerRef worker = std::make_shared<Worker>(delivery);
+            detail::attach(*worker, streams...);
+            worker->start();
+            WorkerManager::getInstance().add(worker);
+            return worker;
+        }
+
+        // stop and join all workers created by make_worker()
+        inline void stop_workers() {
+            WorkerManager::getInstance().stop();
+        }
+
+    }  // namespace msgpacketizer
+}  // namespace msgpack
+}  // namespace arduino
+
+#endif  // MSGPACKETIZER_ENABLE_STREAM && MSGPACKETIZER_ENABLE_THREAD
+
+#endif  // HT_SERIAL_MSGPACKETIZER_WORKER_H
@@ -0,0 +1,189 @@
+// Throughput / latency benchmark of encode, frame and decode pipeline on hosted POSIX builds.
+// Every result is printed as one JSON object per line to stdout (see README.md in this directory).
+
+#ifndef MSGPACKETIZER_ENABLE_POSIX
+#define MSGPACKETIZER_ENABLE_POSIX
+#endif
+#include <MsgPacketizer.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        double min_time_ms {200.};
+        const char* filter {nullptr};
+    };
+
+    Options options;
+    volatile size_t sink {0};  // keeps results alive
+
+    // run `f(n)` with increasing n until it takes longer than min_time_ms
+    template <typename F>
+    void run(const char* name, const char* type, const size_t size, const size_t bytes_per_op, F&& f) {
+        char label[128];
+        std::snprintf(label, sizeof(label), "%s/%s/%zu", name, type, size);
+        if (options.filter && !std::strstr(label, options.filter)) return;
+
+        f(1);  // warm up
+        size_t n = 1;
+        double ns = 0.;
+        while (true) {
+            const auto begin = Clock::now();
+            f(n);
+            ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count();
+            if ((ns >= options.min_time_ms * 1e6) || (n >= ((size_t)1 << 30))) break;
+            n = (ns < 1e6) ? n * 10 : (size_t)((double)n * options.min_time_ms * 1e6 / ns * 1.2) + 1;
+        }
+        const double ns_per_op = ns / (double)n;
+        std::printf(
+            "{\"bench\":\"%s\",\"type\":\"%s\",\"size\":%zu,\"iterations\":%zu,"
+            "\"ns_per_op\":%.1f,\"bytes_per_sec\":%.0f}\n",
+            name,
+            type,
+            size,
+            n,
+            ns_per_op,
+            (double)bytes_per_op * 1e9 / ns_per_op);
+        std::fflush(stdout);
+    }
+
+    const size_t SIZES[] {8, 64, 512, 4096};
+
+    std::string make_string(const size_t size) {
+        std::string s(size, ' ');
+        for (size_t i = 0; i < size; ++i) s[i] = (char)('a' + i % 26);
+        return s;
+    }
+
+    std::vector<uint8_t> make_binary(const size_t size) {
+        std::vector<uint8_t> b(size);
+        for (size_t i = 0; i < size; ++i) b[i] = (uint8_t)i;  // includes zeros for COBS
+        return b;
+    }
+
+    void encode() {
+        const int i = 12345;
+        const float f = 6.789f;
+        run("encode", "int", sizeof(i), sizeof(i), [&](const size_t n) {
+            for (size_t k = 0; k < n; ++k) sink += MsgPacketizer::encode(0x01, i).data.size();
+        });
+        for (const size_t size : SIZES) {
+            const std::string s = make_string(size);
+            const std::vector<uint8_t> b = make_binary(size);
+            run("encode", "str", size, size, [&](const size_t n) {
+                for (size_t k = 0; k < n; ++k) sink += MsgPacketizer::encode(0x01, s).data.size();
+            });
+            run("encode", "bin", size, size, [&](const size_t n) {
+                for (size_t k = 0; k < n; ++k) sink += MsgPacketizer::encode(0x01, b).data.size();
+            });
+            run("encode_arr", "int_float_str", size, size, [&](const size_t n) {
+                for (size_t k = 0; k < n; ++k) sink += MsgPacketizer::encode_arr(0x01, i, f, s).data.size();
+            });
+            run("encode_map", "int_float_str", size, size, [&](const size_t n) {
+                for (size_t k = 0; k < n; ++k)
+                    sink += MsgPacketizer::encode_map(0x01, "i", i, "f", f, "s", s).data.size();
+            });
+        }
+    }
+
+    // frames are written to /dev/null, so this includes one write() per frame
+    void send() {
+        MsgPacketizer::posix::Stream devnull;
+        if (!devnull.open("/dev/null", O_WRONLY)) return;
+        for (const size_t size : SIZES) {
+            const std::vector<uint8_t> b = make_binary(size);
+            run("send", "bin", size, size, [&](const size_t n) {
+                for (size_t k = 0; k < n; ++k) MsgPacketizer::send(devnull, 0x01, b);
+            });
+            // framing only (COBS + CRC into memory)
+            MsgPacketizer::codec::Buffer out;
+            run("frame", "bin", size, size, [&](const size_t n) {
+                for (size_t k = 0; k < n; ++k) {
+                    out.clear();
+                    MsgPacketizer::codec::encode(0x01, b.data(), b.size(), out);
+                }
+                sink += out.size();
+            });
+        }
+    }
+
+    // one frame is fed per operation
+    void decode() {
+        for (const size_t size : SIZES) {
+            const std::string s = make_string(size);
+            const auto& packet = MsgPacketizer::encode(0x01, s);
+            const std::vector<uint8_t> frame(packet.data.begin(), packet.data.end());
+            std::string received;
+            size_t n_received = 0;
+
+            // Packetizer decode + MsgPack unpack + subscriber callback
+            MsgPacketizer::subscribe_manual(0x01, [&](const std::string& v) {
+                received = v;
+                ++n_received;
+            });
+            run("feed", "str", size, size, [&](const size_t n) {
+                for (size_t k = 0; k < n; ++k) MsgPacketizer::feed(frame.data(), frame.size());
+            });
+            MsgPacketizer::unsubscribe_manual(0x01);
+
+            // thread-safe decoder used for posix streams and workers
+            MsgPacketizer::codec::Decoder decoder;
+            MsgPack::Unpacker unpacker;
+            run("codec_decode", "str", size, size, [&](const size_t n) {
+                for (size_t k = 0; k < n; ++k) {
+                    decoder.feed(
+                        frame.data(),
+                        frame.size(),
+                        [&](const uint8_t, const uint8_t* data, const size_t len) {
+                            unpacker.clear();
+                            unpacker.feed(data, len);
+                            unpacker.deserialize(received);
+                            ++n_received;
+                        });
+                }
+            });
+            sink += n_received + received.size();
+        }
+    }
+
+    void post() {
+        MsgPacketizer::posix::Stream devnull;
+        if (!devnull.open("/dev/null", O_WRONLY)) return;
+        static int values[256];
+        for (const size_t topics : {1, 8, 64, 255}) {
+            for (size_t t = 0; t < topics; ++t)
+                MsgPacketizer::publish(devnull, (uint8_t)t, values[t])->setIntervalUsec(0);
+            run("post", "int", topics, topics * sizeof(int), [&](const size_t n) {
+                for (size_t k = 0; k < n; ++k) MsgPacketizer::post();
+            });
+            for (size_t t = 0; t < topics; ++t) MsgPacketizer::unpublish(devnull, (uint8_t)t);
+        }
+    }
+
+}  // namespace bench
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--min-time-ms") && (i + 1 < argc))
+            bench::options.min_time_ms = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--filter") && (i + 1 < argc))
+            bench::options.filter = argv[++i];
+        else {
+            std::fprintf(stderr, "usage: %s [--min-time-ms 200] [--filter encode_arr]\n", argv[0]);
+            return 1;
+        }
+    }
+    bench::encode();
+    bench::send();
+    bench::decode();
+    bench::post();
+    return 0;
+}
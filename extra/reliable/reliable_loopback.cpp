@@ -0,0 +1,84 @@
+// Loopback check of reliable UDP delivery on hosted POSIX builds.
+// Two sockets on localhost exchange messages of one reliable index while 20% of frames (data and acks)
+// are dropped by setReliableLoss(), and every message must be delivered once and in order.
+// Build it like extra/benchmark (see README.md there) and run without arguments, it returns 0 on success.
+
+#ifndef MSGPACKETIZER_ENABLE_POSIX
+#define MSGPACKETIZER_ENABLE_POSIX
+#endif
+#ifndef MSGPACKETIZER_ENABLE_NETWORK
+#define MSGPACKETIZER_ENABLE_NETWORK
+#endif
+#include <MsgPacketizer.h>
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    const char* const HOST {"127.0.0.1"};
+    const uint16_t PORT_TX {46101};
+    const uint16_t PORT_RX {46102};
+    const uint8_t INDEX {0x10};
+    const int N_MESSAGES {2000};
+    const float LOSS {0.2f};
+    const auto TIMEOUT = std::chrono::seconds(30);
+
+}  // namespace
+
+int main() {
+    MsgPacketizer::UDP tx, rx;
+    if (!tx.begin(PORT_TX) || !rx.begin(PORT_RX)) {
+        std::fprintf(stderr, "cannot bind udp ports %u and %u\n", PORT_TX, PORT_RX);
+        return 1;
+    }
+
+    // reliable on both peers so that the receiver returns acks
+    MsgPacketizer::setReliable(tx, HOST, PORT_RX, INDEX);
+    MsgPacketizer::setReliable(rx, HOST, PORT_TX, INDEX);
+    MsgPacketizer::setReliableLoss(tx, INDEX, LOSS);
+    MsgPacketizer::setReliableLoss(rx, INDEX, LOSS);
+
+    std::vector<int> received;
+    received.reserve(N_MESSAGES);
+    MsgPacketizer::subscribe(rx, INDEX, [&](const int i) { received.push_back(i); });
+
+    const auto begin = std::chrono::steady_clock::now();
+    int n_sent = 0;
+    while ((int)received.size() < N_MESSAGES) {
+        if ((std::chrono::steady_clock::now() - begin) > TIMEOUT) {
+            std::fprintf(stderr, "timeout: %zu / %d messages delivered\n", received.size(), N_MESSAGES);
+            return 1;
+        }
+        // send() drops messages while the window is full, so wait for acks
+        while ((n_sent < N_MESSAGES)
+               && (MsgPacketizer::getReliableStats(tx, INDEX).in_flight < MsgPacketizer::reliable::WINDOW))
+            MsgPacketizer::send(tx, HOST, PORT_RX, INDEX, n_sent++);
+        MsgPacketizer::update();
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+
+    for (int i = 0; i < N_MESSAGES; ++i) {
+        if (received[i] != i) {
+            std::fprintf(stderr, "out of order: message %d received at %d\n", received[i], i);
+            return 1;
+        }
+    }
+
+    const auto s = MsgPacketizer::getReliableStats(tx, INDEX);
+    const auto r = MsgPacketizer::getReliableStats(rx, INDEX);
+    std::printf(
+        "delivered %zu messages in order with %.0f%% loss: sent %u, retransmitted %u, rtt %u us, "
+        "duplicates %u, reordered %u, acks %u\n",
+        received.size(),
+        LOSS * 100.f,
+        s.sent,
+        s.retransmitted,
+        s.rtt_us,
+        r.duplicates,
+        r.reordered,
+        r.acks_sent);
+    return 0;
+}